@@ -27,9 +27,65 @@ class SUBSTANCECORE_API USubstanceSettings : public UObject
 	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1", ClampMax = "12"))
 	int32 CPUCores;
 
+	// number of independent engines rendering in parallel, CPU cores and memory budget are shared between them
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1", ClampMax = "8"))
+	int32 RenderWorkers;
+
+	// adapt the number of cores used by the engine (up to CPUCores) to the frame time headroom
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget")
+	bool bAdaptiveCores;
+
+	// game/render thread frame time the adaptive cores governor tries to stay under
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "1.0", ClampMax = "100.0", EditCondition = "bAdaptiveCores"))
+	float FrameTimeTargetMs;
+
+	// game thread time spent publishing computed outputs per frame, 0 for no limit (at least one output is published per frame)
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "0.0", ClampMax = "100.0"))
+	float OutputUploadBudgetMs;
+
+	// size of the computed outputs published per frame, in KB, 0 for no limit (at least one output is published per frame)
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "0"))
+	int32 OutputUploadBudgetKb;
+
+	// size of the texture uploads per frame on the render thread, in KB, 0 for no limit (larger uploads are spread over several frames)
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget", meta = (ClampMin = "0"))
+	int32 TextureUploadBudgetKb;
+
+	// compress the uncompressed (RGBA) outputs on the CPU before upload: BC5 for normal maps, BC4 for masks and greyscale channels, BC3 for diffuse, BC1 otherwise
+	UPROPERTY(EditAnywhere, Config, Category = "Hardware Budget")
+	bool bCompressRawOutputs;
+
+	// render runtime outputs at a reduced size first, higher mips are rendered when their textures are drawn
+	UPROPERTY(EditAnywhere, Config, Category = "Streaming")
+	bool bGenerateMipsOnDemand;
+
+	// size of the first render of the outputs generated on demand (log2, 7 for 128x128)
+	UPROPERTY(EditAnywhere, Config, Category = "Streaming", meta = (ClampMin = "0", ClampMax = "13", EditCondition = "bGenerateMipsOnDemand"))
+	int32 InitialMipSizeLog2;
+
+	// keep linked Substance binaries on disk to skip linking at next start
+	UPROPERTY(EditAnywhere, Config, Category = "Cache")
+	bool bCacheLinkedBinaries;
+
+	// maximum size of the disk cache of the linked binaries, in MB, 0 for no limit (least recently used entries are evicted when a new one is written)
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "0", EditCondition = "bCacheLinkedBinaries"))
+	int32 LinkCacheMaxSizeMb;
+
+	// deflate the uncompressed outputs stored in the disk cache, block compressed outputs are stored as is
+	UPROPERTY(EditAnywhere, Config, Category = "Cache")
+	bool bCompressCacheEntries;
+
+	// maximum size of the disk cache of the outputs, in MB, 0 for no limit (bound applied at startup: least recently used entries are evicted, once full during a session new entries are not cached until next start)
+	UPROPERTY(EditAnywhere, Config, Category = "Cache", meta = (ClampMin = "0"))
+	int32 CacheMaxSizeMb;
+
 	UPROPERTY(EditAnywhere, Config, Category = "Cooking", meta = (ClampMin = "1", ClampMax = "5", DisplayName = "Mip levels count removed during cooking."))
 	int32 AsyncLoadMipClip;
 
 	UPROPERTY(EditAnywhere, Config, Category = "Cooking", meta = (DisplayName = "Default generation mode for Substances."))
 	TEnumAsByte<ESubstanceGenerationMode> DefaultGenerationMode;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 };
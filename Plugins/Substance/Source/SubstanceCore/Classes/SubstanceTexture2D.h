@@ -27,6 +27,9 @@ class USubstanceTexture2D : public UTexture2DDynamic
 
 	TIndirectArray<struct FTexture2DMipMap> Mips;
 
+	/** While the texture has no mips, its resource uses the shared placeholder texture, see Substance::Helpers::CreatePlaceHolderMips */
+	bool bUsePlaceholder;
+
 	// Begin UObject interface.
 	virtual void Serialize( FArchive& Ar ) override;
 	virtual void BeginDestroy() override;
@@ -42,4 +45,7 @@ class USubstanceTexture2D : public UTexture2DDynamic
 	virtual void UpdateResource() override;
 	virtual FTextureResource* CreateResource() override;
 	// End UTexture interface.
+
+	/** Recreate the resource without uploading the mips, see Substance::TextureUploadBatch */
+	void RecreateResource();
 };
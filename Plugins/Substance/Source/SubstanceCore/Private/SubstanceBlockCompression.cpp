@@ -0,0 +1,441 @@
+//! @file SubstanceBlockCompression.cpp
+//! @brief CPU block compression of the uncompressed Substance outputs
+//! @date 20150326
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceBlockCompression.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceFOutput.h"
+#include "SubstanceSettings.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SUBSTANCE_BLOCK_SSE2 1
+#define SUBSTANCE_BLOCK_NEON 0
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SUBSTANCE_BLOCK_SSE2 0
+#define SUBSTANCE_BLOCK_NEON 1
+#include <arm_neon.h>
+#else
+#define SUBSTANCE_BLOCK_SSE2 0
+#define SUBSTANCE_BLOCK_NEON 0
+#endif
+
+DECLARE_CYCLE_STAT(TEXT("Compress Outputs"), STAT_SubstanceCompressOutputs, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Compressed Mips"), STAT_SubstanceCompressedMips, STATGROUP_Substance);
+
+namespace
+{
+	//! @brief Images smaller than this count of blocks are compressed by the calling thread only
+	const int32 MinParallelBlocks = 4096;
+
+	//! @brief Maximum count of pool threads working on the same image
+	const int32 MaxWorkers = 7;
+
+	//! @brief Copy a 4x4 block in RGBA order, out of range pixels are clamped
+	void FetchBlock(uint8* Block, const uint8* Src, int32 SizeX, int32 SizeY, int32 BlockX, int32 BlockY, bool bSrcBGRA)
+	{
+		const int32 IdxR = bSrcBGRA ? 2 : 0;
+		const int32 IdxB = bSrcBGRA ? 0 : 2;
+
+		for (int32 Y = 0; Y < 4; ++Y)
+		{
+			const int32 SrcY = FMath::Min(BlockY * 4 + Y, SizeY - 1);
+			const uint8* Row = Src + (SIZE_T)SrcY * SizeX * 4;
+
+			for (int32 X = 0; X < 4; ++X)
+			{
+				const uint8* Pixel = Row + FMath::Min(BlockX * 4 + X, SizeX - 1) * 4;
+				uint8* Texel = Block + (Y * 4 + X) * 4;
+
+				Texel[0] = Pixel[IdxR];
+				Texel[1] = Pixel[1];
+				Texel[2] = Pixel[IdxB];
+				Texel[3] = Pixel[3];
+			}
+		}
+	}
+
+	//! @brief Per channel minimum and maximum of a block
+	void GetBlockBounds(const uint8* Block, uint8* Min, uint8* Max)
+	{
+#if SUBSTANCE_BLOCK_SSE2
+		const __m128i P0 = _mm_loadu_si128((const __m128i*)(Block + 0));
+		const __m128i P1 = _mm_loadu_si128((const __m128i*)(Block + 16));
+		const __m128i P2 = _mm_loadu_si128((const __m128i*)(Block + 32));
+		const __m128i P3 = _mm_loadu_si128((const __m128i*)(Block + 48));
+
+		// 16 pixels to 4, then folded to 1
+		__m128i MinV = _mm_min_epu8(_mm_min_epu8(P0, P1), _mm_min_epu8(P2, P3));
+		__m128i MaxV = _mm_max_epu8(_mm_max_epu8(P0, P1), _mm_max_epu8(P2, P3));
+		MinV = _mm_min_epu8(MinV, _mm_shuffle_epi32(MinV, _MM_SHUFFLE(1, 0, 3, 2)));
+		MaxV = _mm_max_epu8(MaxV, _mm_shuffle_epi32(MaxV, _MM_SHUFFLE(1, 0, 3, 2)));
+		MinV = _mm_min_epu8(MinV, _mm_shuffle_epi32(MinV, _MM_SHUFFLE(2, 3, 0, 1)));
+		MaxV = _mm_max_epu8(MaxV, _mm_shuffle_epi32(MaxV, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		const int32 MinPixel = _mm_cvtsi128_si32(MinV);
+		const int32 MaxPixel = _mm_cvtsi128_si32(MaxV);
+		FMemory::Memcpy(Min, &MinPixel, 4);
+		FMemory::Memcpy(Max, &MaxPixel, 4);
+#elif SUBSTANCE_BLOCK_NEON
+		const uint8x16_t P0 = vld1q_u8(Block + 0);
+		const uint8x16_t P1 = vld1q_u8(Block + 16);
+		const uint8x16_t P2 = vld1q_u8(Block + 32);
+		const uint8x16_t P3 = vld1q_u8(Block + 48);
+
+		// 16 pixels to 4, then folded to 1
+		const uint8x16_t MinQ = vminq_u8(vminq_u8(P0, P1), vminq_u8(P2, P3));
+		const uint8x16_t MaxQ = vmaxq_u8(vmaxq_u8(P0, P1), vmaxq_u8(P2, P3));
+		uint8x8_t MinV = vmin_u8(vget_low_u8(MinQ), vget_high_u8(MinQ));
+		uint8x8_t MaxV = vmax_u8(vget_low_u8(MaxQ), vget_high_u8(MaxQ));
+		MinV = vmin_u8(MinV, vreinterpret_u8_u32(vrev64_u32(vreinterpret_u32_u8(MinV))));
+		MaxV = vmax_u8(MaxV, vreinterpret_u8_u32(vrev64_u32(vreinterpret_u32_u8(MaxV))));
+
+		uint8 Pixels[16];
+		vst1_u8(Pixels, MinV);
+		vst1_u8(Pixels + 8, MaxV);
+		FMemory::Memcpy(Min, Pixels, 4);
+		FMemory::Memcpy(Max, Pixels + 8, 4);
+#else
+		FMemory::Memcpy(Min, Block, 4);
+		FMemory::Memcpy(Max, Block, 4);
+
+		for (int32 Idx = 4; Idx < 64; ++Idx)
+		{
+			Min[Idx & 3] = FMath::Min(Min[Idx & 3], Block[Idx]);
+			Max[Idx & 3] = FMath::Max(Max[Idx & 3], Block[Idx]);
+		}
+#endif
+	}
+
+	//! @brief Pack a color to 5:6:5, rounded to the nearest
+	uint16 ToColor565(const int32* Color)
+	{
+		const int32 R = (Color[0] * 31 + 127) / 255;
+		const int32 G = (Color[1] * 63 + 127) / 255;
+		const int32 B = (Color[2] * 31 + 127) / 255;
+
+		return (uint16)((R << 11) | (G << 5) | B);
+	}
+
+	//! @brief Unpack a 5:6:5 color, as decoded by the hardware
+	void FromColor565(uint16 Packed, int32* Color)
+	{
+		const int32 R = (Packed >> 11) & 0x1F;
+		const int32 G = (Packed >> 5) & 0x3F;
+		const int32 B = Packed & 0x1F;
+
+		Color[0] = (R << 3) | (R >> 2);
+		Color[1] = (G << 2) | (G >> 4);
+		Color[2] = (B << 3) | (B >> 2);
+	}
+
+	//! @brief Encode the color of a block (BC1, color part of BC3), 8 bytes
+	void EncodeColorBlock(uint8* Dest, const uint8* Block, const uint8* Min, const uint8* Max)
+	{
+		// inset the bounding box by 1/16 of its size, lowers the mean error
+		int32 Lo[3], Hi[3];
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			const int32 Inset = (Max[Channel] - Min[Channel]) >> 4;
+			Lo[Channel] = Min[Channel] + Inset;
+			Hi[Channel] = Max[Channel] - Inset;
+		}
+
+		// the max end point packs to the larger value: 4 colors mode
+		const uint16 Color0 = ToColor565(Hi);
+		const uint16 Color1 = ToColor565(Lo);
+		uint32 Indices = 0;
+
+		if (Color0 != Color1)
+		{
+			int32 End0[3], End1[3];
+			FromColor565(Color0, End0);
+			FromColor565(Color1, End1);
+
+			const int32 Dir[3] = { End0[0] - End1[0], End0[1] - End1[1], End0[2] - End1[2] };
+			const int32 DirLength = Dir[0] * Dir[0] + Dir[1] * Dir[1] + Dir[2] * Dir[2];
+
+			// position on the axis from Color1 to Color0 -> palette index
+			static const uint32 Remap[4] = { 1, 3, 2, 0 };
+
+			for (int32 Idx = 0; Idx < 16; ++Idx)
+			{
+				const uint8* Texel = Block + Idx * 4;
+				const int32 Dot =
+					(Texel[0] - End1[0]) * Dir[0] +
+					(Texel[1] - End1[1]) * Dir[1] +
+					(Texel[2] - End1[2]) * Dir[2];
+
+				const int32 Pos = Dot <= 0 ? 0 :
+					FMath::Min((Dot * 3 + DirLength / 2) / DirLength, 3);
+
+				Indices |= Remap[Pos] << (Idx * 2);
+			}
+		}
+
+		Dest[0] = (uint8)(Color0 & 0xFF);
+		Dest[1] = (uint8)(Color0 >> 8);
+		Dest[2] = (uint8)(Color1 & 0xFF);
+		Dest[3] = (uint8)(Color1 >> 8);
+		Dest[4] = (uint8)(Indices & 0xFF);
+		Dest[5] = (uint8)((Indices >> 8) & 0xFF);
+		Dest[6] = (uint8)((Indices >> 16) & 0xFF);
+		Dest[7] = (uint8)(Indices >> 24);
+	}
+
+	//! @brief Encode one channel of a block (BC4, alpha part of BC3), 8 bytes
+	void EncodeChannelBlock(uint8* Dest, const uint8* Block, int32 Channel, uint8 Min, uint8 Max)
+	{
+		// max end point first: 8 values mode
+		Dest[0] = Max;
+		Dest[1] = Min;
+		uint64 Indices = 0;
+
+		if (Max != Min)
+		{
+			const int32 Range = Max - Min;
+
+			for (int32 Idx = 0; Idx < 16; ++Idx)
+			{
+				// position from Min (0) to Max (7) -> palette index
+				const int32 Pos = ((Block[Idx * 4 + Channel] - Min) * 7 + Range / 2) / Range;
+				const uint64 Index = Pos == 7 ? 0 : (Pos == 0 ? 1 : 8 - Pos);
+
+				Indices |= Index << (Idx * 3);
+			}
+		}
+
+		for (int32 Idx = 0; Idx < 6; ++Idx)
+		{
+			Dest[2 + Idx] = (uint8)((Indices >> (Idx * 8)) & 0xFF);
+		}
+	}
+
+	//! @brief Encode a block in the given format
+	void EncodeBlock(uint8* Dest, const uint8* Block, EPixelFormat Format)
+	{
+		uint8 Min[4], Max[4];
+		GetBlockBounds(Block, Min, Max);
+
+		switch (Format)
+		{
+		case PF_DXT1:
+			EncodeColorBlock(Dest, Block, Min, Max);
+			break;
+		case PF_DXT5:
+			EncodeChannelBlock(Dest, Block, 3, Min[3], Max[3]);
+			EncodeColorBlock(Dest + 8, Block, Min, Max);
+			break;
+		case PF_BC4:
+			EncodeChannelBlock(Dest, Block, 0, Min[0], Max[0]);
+			break;
+		case PF_BC5:
+			EncodeChannelBlock(Dest, Block, 0, Min[0], Max[0]);
+			EncodeChannelBlock(Dest + 8, Block, 1, Min[1], Max[1]);
+			break;
+		default:
+			check(0);
+			break;
+		}
+	}
+
+	//! @brief Return if an output holds a single channel: greyscale format,
+	//!	or RGBA result w/ equal color channels and opaque alpha
+	bool IsSingleChannel(const output_desc_t* Desc, const SubstanceTexture& Result)
+	{
+		if ((Desc->Format & ~(Substance_PF_sRGB | Substance_PF_16b)) == Substance_PF_L)
+		{
+			return true;
+		}
+
+		// top mip only: the others are downsampled from it
+		const uint8* Pixel = (const uint8*)Result.buffer;
+		const uint8* End = Pixel + (SIZE_T)Result.level0Width * Result.level0Height * 4;
+
+		for (; Pixel < End; Pixel += 4)
+		{
+			if (Pixel[0] != Pixel[1] || Pixel[0] != Pixel[2] || Pixel[3] != 0xFF)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//! @brief Compression of one image, shared by the threads working on it
+	struct FCompressionContext
+	{
+		uint8* Dest;
+		const uint8* Src;
+		int32 SizeX;
+		int32 SizeY;
+		bool bSrcBGRA;
+		EPixelFormat Format;
+
+		int32 BlocksX;
+		int32 BlocksY;
+
+		//! @brief Next row of blocks to compress
+		FThreadSafeCounter NextRow;
+
+		//! @brief Pool threads not done yet
+		FThreadSafeCounter PendingWorkers;
+
+		//! @brief Triggered when the last pool thread is done
+		FEvent* DoneEvent;
+
+		//! @brief Compress rows of blocks until none is left
+		void CompressRows()
+		{
+			const int32 BlockBytes = GPixelFormats[Format].BlockBytes;
+			uint8 Block[64];
+
+			for (int32 Row = NextRow.Increment() - 1; Row < BlocksY; Row = NextRow.Increment() - 1)
+			{
+				uint8* RowDest = Dest + (SIZE_T)Row * BlocksX * BlockBytes;
+
+				for (int32 BlockX = 0; BlockX < BlocksX; ++BlockX)
+				{
+					FetchBlock(Block, Src, SizeX, SizeY, BlockX, Row, bSrcBGRA);
+					EncodeBlock(RowDest + BlockX * BlockBytes, Block, Format);
+				}
+			}
+		}
+
+		//! @brief Notify a pool thread as done
+		void WorkerDone()
+		{
+			if (PendingWorkers.Decrement() == 0)
+			{
+				DoneEvent->Trigger();
+			}
+		}
+	};
+
+	//! @brief Pool thread share of an image compression
+	class FCompressionWork : public IQueuedWork
+	{
+	public:
+		FCompressionWork(FCompressionContext* InContext)
+			: Context(InContext)
+		{
+		}
+
+		virtual void DoThreadedWork() override
+		{
+			Context->CompressRows();
+			Context->WorkerDone();
+		}
+
+		virtual void Abandon() override
+		{
+			Context->WorkerDone();
+		}
+
+	private:
+		FCompressionContext* Context;
+	};
+}
+
+namespace Substance
+{
+namespace BlockCompression
+{
+
+EPixelFormat GetFormat(const output_inst_t* Output, const SubstanceTexture& Result)
+{
+	if (!GetDefault<USubstanceSettings>()->bCompressRawOutputs ||
+		(Result.pixelFormat & ~Substance_PF_sRGB) != Substance_PF_RGBA)
+	{
+		return PF_Unknown;
+	}
+
+	const output_desc_t* Desc = Output->GetOutputDesc();
+
+	switch (Desc ? Desc->Channel : CHAN_Undef)
+	{
+	case CHAN_Normal:
+		return PF_BC5;
+
+	case CHAN_Mask:
+	case CHAN_Opacity:
+	case CHAN_AmbientOcclusion:
+	case CHAN_Bump:
+	case CHAN_Height:
+	case CHAN_Displacement:
+	case CHAN_SpecularLevel:
+	case CHAN_Glossiness:
+	case CHAN_Roughness:
+	case CHAN_Metallic:
+		// packed masks (e.g. RGBA channels) would lose G, B and A in BC4
+		return IsSingleChannel(Desc, Result) ? PF_BC4 : PF_DXT5;
+
+	case CHAN_Diffuse:
+		return PF_DXT5;
+
+	default:
+		return PF_DXT1;
+	}
+}
+
+
+void Compress(uint8* Dest, const uint8* Src, int32 SizeX, int32 SizeY, bool bSrcBGRA, EPixelFormat Format)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SubstanceCompressOutputs);
+
+	FCompressionContext Context;
+	Context.Dest = Dest;
+	Context.Src = Src;
+	Context.SizeX = SizeX;
+	Context.SizeY = SizeY;
+	Context.bSrcBGRA = bSrcBGRA;
+	Context.Format = Format;
+	Context.BlocksX = (SizeX + 3) / 4;
+	Context.BlocksY = (SizeY + 3) / 4;
+	Context.DoneEvent = NULL;
+
+	// one row of blocks per job at least, the calling thread takes its share
+	const int32 NumWorkers =
+		(GThreadPool != NULL && Context.BlocksX * Context.BlocksY >= MinParallelBlocks) ?
+			FMath::Min3(FPlatformMisc::NumberOfCores() - 1, MaxWorkers, Context.BlocksY - 1) :
+			0;
+
+	TArray<FCompressionWork> Works;
+
+	if (NumWorkers > 0)
+	{
+		Context.DoneEvent = FPlatformProcess::CreateSynchEvent(true);
+		Context.PendingWorkers.Set(NumWorkers);
+
+		Works.Reserve(NumWorkers);
+		for (int32 Idx = 0; Idx < NumWorkers; ++Idx)
+		{
+			Works.Add(FCompressionWork(&Context));
+			GThreadPool->AddQueuedWork(&Works[Idx]);
+		}
+	}
+
+	Context.CompressRows();
+
+	if (NumWorkers > 0)
+	{
+		// jobs not started yet have nothing left to do, do not wait for them
+		for (int32 Idx = 0; Idx < NumWorkers; ++Idx)
+		{
+			if (GThreadPool->RetractQueuedWork(&Works[Idx]))
+			{
+				Context.WorkerDone();
+			}
+		}
+
+		Context.DoneEvent->Wait();
+		delete Context.DoneEvent;
+	}
+
+	INC_DWORD_STAT(STAT_SubstanceCompressedMips);
+}
+
+} // namespace BlockCompression
+} // namespace Substance
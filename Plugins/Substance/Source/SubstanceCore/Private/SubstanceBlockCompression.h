@@ -0,0 +1,32 @@
+//! @file SubstanceBlockCompression.h
+//! @brief CPU block compression of the uncompressed Substance outputs
+//! @date 20150326
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Compresses the raw RGBA8 outputs to BC1, BC3, BC4 or BC5
+	//! before they are published: 4 to 8 times less memory to upload and
+	//! to keep in video memory.
+	//! Fast range fit encoder: only the block bounds are vectorized (SSE2,
+	//! NEON), the end points and indices encoders are scalar. Block rows
+	//! are spread on the worker thread pool.
+	namespace BlockCompression
+	{
+		//! @brief Return the compressed format of an output render result
+		//! @return Return PF_Unknown if the result must be kept as is: not
+		//!		raw RGBA8, or compression disabled in the settings
+		//! @note The format is chosen per output channel: normal maps to
+		//!		BC5, masks and greyscale channels to BC4 if they hold a single
+		//!		channel (BC3 otherwise), diffuse to BC3 and other colors to BC1
+		EPixelFormat GetFormat(const output_inst_t* Output, const SubstanceTexture& Result);
+
+		//! @brief Compress an image
+		//! @param Dest Destination blocks, CalculateImageBytes(SizeX, SizeY, 0, Format) bytes
+		//! @param Src Source RGBA8 or BGRA8 pixels, SizeX * SizeY * 4 bytes
+		//! @param bSrcBGRA True if the source is in BGRA order
+		//! @note Sizes not multiple of 4 are padded by clamping
+		void Compress(uint8* Dest, const uint8* Src, int32 SizeX, int32 SizeY, bool bSrcBGRA, EPixelFormat Format);
+	}
+}
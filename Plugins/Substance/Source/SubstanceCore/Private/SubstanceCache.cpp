@@ -4,146 +4,1574 @@
 //! @copyright Allegorithmic. All rights reserved.
 #include "SubstanceCorePrivatePCH.h"
 #include "SubstanceCache.h"
+#include "SubstanceCoreClasses.h"
 #include "SubstanceCoreHelpers.h"
+#include "SubstanceCoreStats.h"
 #include "SubstanceTexture2D.h"
 #include "SubstanceFGraph.h"
+#include "SubstanceFPackage.h"
+#include "SubstanceInput.h"
+#include "SubstanceSettings.h"
+#include "framework/details/detailslinkdata.h"
 
 #include "Paths.h"
+#include "PlatformFilemanager.h"
+#include "SecureHash.h"
 
-#define SUBSTANCECACHE_VERSION 1
+#define SUBSTANCECACHE_VERSION 4
 
 DEFINE_LOG_CATEGORY_STATIC(LogSubstanceCache, Log, All);
 
+DECLARE_MEMORY_STAT(TEXT("Cache Size"), STAT_SubstanceCacheSize, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Cache Bytes Read"), STAT_SubstanceCacheBytesRead, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Cache Bytes Written"), STAT_SubstanceCacheBytesWritten, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cache Hits"), STAT_SubstanceCacheHits, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cache Misses"), STAT_SubstanceCacheMisses, STATGROUP_Substance);
+
 using namespace Substance;
 
 TSharedPtr<SubstanceCache> SubstanceCache::SbsCache;
 
-bool SubstanceCache::CanReadFromCache(FGraphInstance* graph)
+static FAutoConsoleCommand GSubstanceCacheStatsCommand(
+	TEXT("Substance.CacheStats"),
+	TEXT("Log the Substance disk cache size, hits, misses and bytes read and written this session"),
+	FConsoleCommandDelegate::CreateStatic(&SubstanceCache::LogStats));
+
+namespace
 {
-	bool canReadFromCache = false;
-	//make sure all enabled outputs have a cached file
+	//! @brief Alignment of the records in the pack, and of their payloads
+	const int64 ALIGNMENT = 64;
+
+	//! @brief Size of the pack, record and index headers
+	const int64 HEADER_SIZE = ALIGNMENT;
+
+	//! @brief Size of the footer: index offset, entries count and magic
+	const int64 FOOTER_SIZE = 16;
+
+	const uint32 PACK_MAGIC = 0x50534253;		// SBSP
+	const uint32 RECORD_MAGIC = 0x52534253;		// SBSR
+	const uint32 INDEX_MAGIC = 0x49534253;		// SBSI
+
+	int64 AlignOffset(int64 offset)
 	{
-		auto iter = graph->Outputs.itfront();
-		while (iter)
+		return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	FString GetPackPath()
+	{
+		return FString::Printf(TEXT("%s/Substance/Cache.pack"), *FPaths::GameSavedDir());
+	}
+
+	//! @brief Pad the end of the pack with zeros up to the alignment
+	bool PadToAlignment(IFileHandle* pack)
+	{
+		static const uint8 padding[ALIGNMENT] = {0};
+
+		const int64 size = pack->Size();
+		const int64 paddingSize = AlignOffset(size) - size;
+
+		return paddingSize == 0 || (pack->SeekFromEnd(0) && pack->Write(padding, paddingSize));
+	}
+
+	//! @brief Append data at the end of the pack, padded up to the alignment
+	bool AppendAligned(IFileHandle* pack, const uint8* data, int64 size)
+	{
+		return pack->SeekFromEnd(0) &&
+			pack->Write(data, size) &&
+			PadToAlignment(pack);
+	}
+
+	//! @brief Return the compression of an entry payload from its format:
+	//! raw pixels are deflated, block compressed pixels are stored as is
+	ECompressionFlags GetCompressionFlags(uint8 pixelFormat)
+	{
+		if (!GetDefault<USubstanceSettings>()->bCompressCacheEntries ||
+			(pixelFormat & 0x3) != Substance_PF_RAW)
 		{
-			if ((*iter).bIsEnabled)
-			{
-				FString path = GetPathForGuid((*iter).OutputGuid);
+			return COMPRESS_None;
+		}
 
-				if (IFileManager::Get().FileSize(*path) == INDEX_NONE)
-				{
-					return false;
-				}
-				else
-				{
-					canReadFromCache = true;
-				}
-			}
+		return (ECompressionFlags)(COMPRESS_ZLIB | COMPRESS_BiasSpeed);
+	}
 
-			iter++;
+	//! @brief Create an empty pack, truncated if it exists
+	IFileHandle* CreatePack(IPlatformFile& platformFile, const FString& path)
+	{
+		IFileHandle* pack = platformFile.OpenWrite(*path, false, true);
+
+		if (NULL == pack)
+		{
+			return NULL;
+		}
+
+		TArray<uint8> header;
+		{
+			FMemoryWriter Ar(header);
+			uint32 magic = PACK_MAGIC;
+			uint32 version = SUBSTANCECACHE_VERSION;
+			Ar << magic;
+			Ar << version;
+		}
+
+		if (!AppendAligned(pack, header.GetData(), header.Num()))
+		{
+			delete pack;
+			return NULL;
+		}
+
+		return pack;
+	}
+
+	//! @brief Delete the per output cache files written before the pack
+	//!	(Saved/Substance/<guid>.cache), they are never read
+	void DeleteLegacyEntries(const FString& directory)
+	{
+		IFileManager& fileManager = IFileManager::Get();
+
+		TArray<FString> filenames;
+		fileManager.FindFiles(filenames, *(directory / TEXT("*.cache")), true, false);
+
+		for (int32 idx = 0; idx < filenames.Num(); ++idx)
+		{
+			fileManager.Delete(*(directory / filenames[idx]), false, false, true);
+		}
+
+		if (filenames.Num() > 0)
+		{
+			UE_LOG(LogSubstanceCache, Log, TEXT("%d legacy Substance cache files deleted"), filenames.Num());
+		}
+	}
+
+	//! @brief Sort the entries from the most recently used
+	struct FLastAccessGreater
+	{
+		template <typename PairType>
+		bool operator()(const PairType& A, const PairType& B) const
+		{
+			return A.Value.LastAccess > B.Value.LastAccess;
+		}
+	};
+
+	//! @brief Read a fixed size block at the given offset of the pack
+	bool ReadAt(IFileHandle* pack, int64 offset, TArray<uint8>& bytes, int64 size)
+	{
+		bytes.Empty((int32)size);
+		bytes.AddUninitialized((int32)size);
+
+		return pack->Seek(offset) && pack->Read(bytes.GetData(), size);
+	}
+
+	//! @brief Sort the inputs by uid, the list order is not part of the key
+	struct FInputUidLess
+	{
+		bool operator()(const input_inst_t& A, const input_inst_t& B) const
+		{
+			return A.Uid < B.Uid;
+		}
+	};
+
+	//! @brief Hash the content of an image input, a null image is hashed as empty
+	void HashImage(FSHA1& HashState, const std::shared_ptr<ImageInput>& Image)
+	{
+		static const uint8 NullTag = 0;
+
+		if (Image.get() == NULL)
+		{
+			HashState.Update(&NullTag, sizeof(NullTag));
+			return;
+		}
+
+		ImageInput::ScopedAccess Access(Image);
+		const SubstanceTexture& Texture = Access->mTexture;
+
+		HashState.Update((const uint8*)&Texture.level0Width, sizeof(Texture.level0Width));
+		HashState.Update((const uint8*)&Texture.level0Height, sizeof(Texture.level0Height));
+		HashState.Update((const uint8*)&Texture.pixelFormat, sizeof(Texture.pixelFormat));
+		HashState.Update((const uint8*)&Texture.channelsOrder, sizeof(Texture.channelsOrder));
+		HashState.Update((const uint8*)&Texture.mipmapCount, sizeof(Texture.mipmapCount));
+
+		if (Texture.buffer)
+		{
+			HashState.Update((const uint8*)Texture.buffer, Access.getSize());
+		}
+	}
+}
+
+//! @brief Background read of an entry
+struct SubstanceCache::FRead : public IQueuedWork
+{
+	FRead(SubstanceCache* InCache, const FEntry& InEntry) :
+		Cache(InCache),
+		Entry(InEntry),
+		Claims(0),
+		bFailed(false),
+		bOrphan(false),
+		DoneEvent(FPlatformProcess::CreateSynchEvent(true))
+	{
+		FMemory::Memzero(Result);
+	}
+
+	~FRead()
+	{
+		FMemory::Free(Result.buffer);
+		delete DoneEvent;
+	}
+
+	virtual void DoThreadedWork() override
+	{
+		bFailed = !Cache->ReadEntry(Entry, Result);
+		DoneEvent->Trigger();
+	}
+
+	virtual void Abandon() override
+	{
+		bFailed = true;
+		DoneEvent->Trigger();
+	}
+
+	bool IsDone() const
+	{
+		return DoneEvent->Wait(0);
+	}
+
+	//! @brief Wait for the read, done inline if not started yet
+	void Wait()
+	{
+		if (GThreadPool != NULL && GThreadPool->RetractQueuedWork(this))
+		{
+			DoThreadedWork();
 		}
+
+		DoneEvent->Wait();
+	}
+
+	SubstanceCache* Cache;
+
+	const FEntry Entry;
+
+	//! @brief Read payload, valid once done
+	SubstanceTexture Result;
+
+	//! @brief Count of the graph instances waiting for this read
+	int32 Claims;
+
+	bool bFailed;
+
+	//! @brief Unclaimed prefetch no graph instance is expected to ask for
+	bool bOrphan;
+
+	FEvent* DoneEvent;
+};
+
+//! @brief Copy of a result waiting to be written
+struct SubstanceCache::FPendingWrite
+{
+	FSHAHash Key;
+
+	//! @brief Copy of the result, buffer owned
+	SubstanceTexture Result;
+
+	//! @brief Size of the result buffer
+	int64 Size;
+
+	//! @brief Compression of the payload, chosen on the game thread
+	ECompressionFlags Compression;
+};
+
+//! @brief Background writer, one job at a time keeps the appends ordered
+struct SubstanceCache::FWriter : public IQueuedWork
+{
+	FWriter(SubstanceCache* InCache) :
+		Cache(InCache)
+	{
+	}
+
+	virtual void DoThreadedWork() override
+	{
+		Cache->DrainWrites();
+	}
+
+	virtual void Abandon() override
+	{
+		// thread pool destroyed, do not lose the queued results
+		Cache->DrainWrites();
 	}
 
-	return canReadFromCache;
+	SubstanceCache* Cache;
+};
+
+SubstanceCache::SubstanceCache() :
+	Pack(NULL),
+	ReadsBytes(0),
+	PackEnd(0),
+	QueuedWriteBytes(0),
+	bWriterScheduled(false),
+	Writer(new FWriter(this)),
+	WriterIdleEvent(FPlatformProcess::CreateSynchEvent(true)),
+	Hits(0),
+	Misses(0),
+	TotalBytesRead(0),
+	TotalBytesWritten(0),
+	bIndexDirty(false),
+	bPackOpened(false),
+	bPackFull(false),
+	bSharedReads(false)
+{
 }
 
-bool SubstanceCache::ReadFromCache(FGraphInstance* graph)
+SubstanceCache::~SubstanceCache()
+{
+	for (auto itRead = Reads.CreateIterator(); itRead; ++itRead)
+	{
+		itRead.Value()->Wait();
+		delete itRead.Value();
+	}
+
+	FlushWrites();
+
+	CloseReadHandles();
+
+	if (Pack)
+	{
+		WriteIndex();
+		delete Pack;
+	}
+
+	delete Writer;
+	delete WriterIdleEvent;
+}
+
+bool SubstanceCache::CanReadFromCache(FGraphInstance* graph)
 {
-	if (!CanReadFromCache(graph))
+	TArray<FSHAHash> keys;
+
+	return GetEntriesKeys(graph, keys);
+}
+
+bool SubstanceCache::GetEntriesKeys(FGraphInstance* graph, TArray<FSHAHash>& outKeys)
+{
+	FSHAHash graphKey;
+
+	if (!GetGraphKey(graph, graphKey) || !OpenPack())
 	{
 		return false;
 	}
 
-	//read in cached data and upload
+	MergeWrittenEntries();
+
+	//make sure all enabled outputs have an entry
 	auto iter = graph->Outputs.itfront();
 	while (iter)
 	{
 		if ((*iter).bIsEnabled)
 		{
-			FOutputInstance& outputInstance = *(iter);
-			FString path = GetPathForGuid(outputInstance.OutputGuid);
-			FArchive* Ar = IFileManager::Get().CreateFileReader(*path);
-
-			if (Ar)
-			{
-				SubstanceTexture output;
-				FMemory::MemZero(output);
+			FSHAHash outputKey;
+			GetOutputKey(graphKey, &(*iter), outputKey);
 
-				if (SerializeTexture(*Ar, output))
-				{
-					delete Ar;
-
-					USubstanceTexture2D* texture = *((outputInstance.Texture).get());
-					Substance::Helpers::UpdateTexture(output, &outputInstance, false);
-
-					FMemory::Free(output.buffer);
-				}
-				else
-				{
-					delete Ar;
-					return false;
-				}
-			}
-			else
+			if (NULL == Entries.Find(outputKey))
 			{
 				return false;
 			}
+
+			outKeys.Add(outputKey);
 		}
 
 		iter++;
 	}
 
-	return true;
+	return outKeys.Num() != 0;
 }
 
-void SubstanceCache::CacheOutput(output_inst_t* output, const SubstanceTexture& result)
+void SubstanceCache::LogStats()
 {
-	FString filename = GetPathForGuid(output->OutputGuid);
-	FArchive* Ar = IFileManager::Get().CreateFileWriter(*filename, 0);
+	SubstanceCache* cache = SbsCache.Get();
 
-	if (Ar)
+	if (NULL == cache || NULL == cache->Pack)
 	{
-		SerializeTexture(*Ar, const_cast<SubstanceTexture&>(result));
-		delete Ar;
+		UE_LOG(LogSubstanceCache, Display, TEXT("Substance cache not opened"));
+		return;
 	}
+
+	cache->MergeWrittenEntries();
+
+	FScopeLock ScopeLock(&cache->PackLock);
+
+	const int32 maxSizeMb = GetDefault<USubstanceSettings>()->CacheMaxSizeMb;
+
+	UE_LOG(LogSubstanceCache, Display, TEXT("Substance cache: %d entries, %u KB (max %d MB)"),
+		cache->Entries.Num(),
+		(uint32)(cache->PackEnd / 1024),
+		maxSizeMb);
+	UE_LOG(LogSubstanceCache, Display, TEXT("  %u hits, %u misses, %u KB read, %u KB written"),
+		cache->Hits,
+		cache->Misses,
+		(uint32)(cache->TotalBytesRead / 1024),
+		(uint32)(cache->TotalBytesWritten / 1024));
 }
 
-FString SubstanceCache::GetPathForGuid(const FGuid& guid) const
+void SubstanceCache::CountLookup(bool bHit)
 {
-	return FString::Printf(TEXT("%s/Substance/%s.cache"), *FPaths::GameSavedDir(), *(guid.ToString()));
+	if (bHit)
+	{
+		++Hits;
+		INC_DWORD_STAT(STAT_SubstanceCacheHits);
+	}
+	else
+	{
+		++Misses;
+		INC_DWORD_STAT(STAT_SubstanceCacheMisses);
+	}
 }
 
-bool SubstanceCache::SerializeTexture(FArchive& Ar, SubstanceTexture& result) const
+bool SubstanceCache::ReadFromCache(FGraphInstance* graph)
 {
-	uint32 version = SUBSTANCECACHE_VERSION;
+	TArray<FSHAHash> keys;
+
+	const bool bHit = GetEntriesKeys(graph, keys);
+	CountLookup(bHit);
+
+	if (!bHit)
+	{
+		return false;
+	}
 
-	Ar << version;
+	// issue all the reads first, they proceed while waiting for the first one
+	TArray<FRead*> graphReads;
 
-	if (Ar.IsLoading())
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
 	{
-		if (version != SUBSTANCECACHE_VERSION)
+		graphReads.Add(IssueRead(keys[idx]));
+	}
+
+	bool bSucceeded = true;
+
+	for (int32 idx = 0; idx < graphReads.Num(); ++idx)
+	{
+		graphReads[idx]->Wait();
+		bSucceeded = bSucceeded && !graphReads[idx]->bFailed;
+	}
+
+	//upload the cached data
+	if (bSucceeded)
+	{
+		int32 idx = 0;
+
+		auto iter = graph->Outputs.itfront();
+		while (iter)
 		{
-			UE_LOG(LogSubstanceCache, Warning, TEXT("Out of date Substance cache entry, will regenerate"));	
-			return false;
+			if ((*iter).bIsEnabled)
+			{
+				Substance::Helpers::UpdateTexture(graphReads[idx++]->Result, &(*iter), false);
+			}
+
+			iter++;
 		}
 	}
 
-	Ar << result.level0Width;
-	Ar << result.level0Height;
-	Ar << result.pixelFormat;
-	Ar << result.channelsOrder;
-	Ar << result.mipmapCount;
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
+	{
+		ReleaseRead(keys[idx]);
+	}
+
+	return bSucceeded;
+}
 
-	EPixelFormat pixelFormat = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)result.pixelFormat);
-	SIZE_T bufferSize = CalcTextureSize(result.level0Width, result.level0Height, pixelFormat, result.mipmapCount);
+bool SubstanceCache::ReadFromCacheAsync(FGraphInstance* graph)
+{
+	FPendingGraph pendingGraph;
+	pendingGraph.Graph = graph;
+
+	const bool bHit = GetEntriesKeys(graph, pendingGraph.Keys);
+	CountLookup(bHit);
+
+	if (!bHit)
+	{
+		return false;
+	}
 
-	if (Ar.IsLoading())
+	for (int32 idx = 0; idx < pendingGraph.Keys.Num(); ++idx)
 	{
-		check(result.buffer == NULL);
-		result.buffer = FMemory::Malloc(bufferSize);
+		IssueRead(pendingGraph.Keys[idx]);
 	}
-	
-	Ar.Serialize(result.buffer, bufferSize);
-	
+
+	PendingGraphs.Add(pendingGraph);
+
 	return true;
 }
+
+void SubstanceCache::Prefetch(FGraphInstance* graph)
+{
+	const int64 maxPrefetchBytes = 256 * 1024 * 1024;
+
+	TArray<FSHAHash> keys;
+
+	if (ReadsBytes >= maxPrefetchBytes || !GetEntriesKeys(graph, keys))
+	{
+		return;
+	}
+
+	for (int32 idx = 0; idx < keys.Num(); ++idx)
+	{
+		FRead* read = IssueRead(keys[idx]);
+
+		// not claimed until the graph is actually read
+		--read->Claims;
+	}
+}
+
+void SubstanceCache::DropPrefetches()
+{
+	for (auto itRead = Reads.CreateIterator(); itRead; ++itRead)
+	{
+		if (itRead.Value()->Claims == 0)
+		{
+			itRead.Value()->bOrphan = true;
+		}
+	}
+}
+
+void SubstanceCache::PublishReads(
+	Substance::List<graph_inst_t*>& completedGraphs,
+	Substance::List<graph_inst_t*>& failedGraphs)
+{
+	for (int32 idxGraph = 0; idxGraph < PendingGraphs.Num();)
+	{
+		FPendingGraph& pendingGraph = PendingGraphs[idxGraph];
+
+		bool bDone = true;
+		bool bSucceeded = true;
+
+		for (int32 idx = 0; idx < pendingGraph.Keys.Num() && bDone; ++idx)
+		{
+			const FRead* read = Reads.FindChecked(pendingGraph.Keys[idx]);
+
+			bDone = read->IsDone();
+			bSucceeded = bSucceeded && !read->bFailed;
+		}
+
+		if (!bDone)
+		{
+			++idxGraph;
+			continue;
+		}
+
+		if (bSucceeded)
+		{
+			int32 idx = 0;
+
+			auto iter = pendingGraph.Graph->Outputs.itfront();
+			while (iter)
+			{
+				if ((*iter).bIsEnabled)
+				{
+					const FRead* read = Reads.FindChecked(pendingGraph.Keys[idx++]);
+					Substance::Helpers::UpdateTexture(read->Result, &(*iter), false);
+				}
+
+				iter++;
+			}
+
+			completedGraphs.push(pendingGraph.Graph);
+		}
+		else
+		{
+			failedGraphs.push(pendingGraph.Graph);
+		}
+
+		for (int32 idx = 0; idx < pendingGraph.Keys.Num(); ++idx)
+		{
+			ReleaseRead(pendingGraph.Keys[idx]);
+		}
+
+		PendingGraphs.RemoveAt(idxGraph);
+	}
+
+	// orphan prefetches, done since they were dropped
+	for (auto itRead = Reads.CreateIterator(); itRead; ++itRead)
+	{
+		FRead* read = itRead.Value();
+
+		if (read->bOrphan && read->Claims == 0 && read->IsDone())
+		{
+			ReadsBytes -= read->Entry.RawSize;
+			delete read;
+			itRead.RemoveCurrent();
+		}
+	}
+}
+
+bool SubstanceCache::CancelReads(FGraphInstance* graph)
+{
+	bool bCanceled = false;
+
+	for (int32 idxGraph = PendingGraphs.Num() - 1; idxGraph >= 0; --idxGraph)
+	{
+		if (PendingGraphs[idxGraph].Graph == graph)
+		{
+			const TArray<FSHAHash> keys = PendingGraphs[idxGraph].Keys;
+			PendingGraphs.RemoveAt(idxGraph);
+			bCanceled = true;
+
+			for (int32 idx = 0; idx < keys.Num(); ++idx)
+			{
+				ReleaseRead(keys[idx]);
+			}
+		}
+	}
+
+	return bCanceled;
+}
+
+bool SubstanceCache::IsReading(FGraphInstance* graph) const
+{
+	for (int32 idxGraph = 0; idxGraph < PendingGraphs.Num(); ++idxGraph)
+	{
+		if (PendingGraphs[idxGraph].Graph == graph)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+SubstanceCache::FRead* SubstanceCache::IssueRead(const FSHAHash& key)
+{
+	FRead** found = Reads.Find(key);
+	FRead* read = found ? *found : NULL;
+
+	if (NULL == read)
+	{
+		FEntry& entry = Entries.FindChecked(key);
+
+		// persisted with the index, orders the eviction
+		entry.LastAccess = FDateTime::UtcNow().ToUnixTimestamp();
+		bIndexDirty = true;
+
+		read = new FRead(this, entry);
+		Reads.Add(key, read);
+		ReadsBytes += read->Entry.RawSize;
+
+		TotalBytesRead += entry.Size;
+		INC_MEMORY_STAT_BY(STAT_SubstanceCacheBytesRead, entry.Size);
+
+		if (GThreadPool != NULL)
+		{
+			GThreadPool->AddQueuedWork(read);
+		}
+		else
+		{
+			read->DoThreadedWork();
+		}
+	}
+
+	++read->Claims;
+	read->bOrphan = false;
+
+	return read;
+}
+
+void SubstanceCache::ReleaseRead(const FSHAHash& key)
+{
+	FRead* read = Reads.FindChecked(key);
+
+	if (--read->Claims > 0)
+	{
+		return;
+	}
+
+	if (read->IsDone())
+	{
+		ReadsBytes -= read->Entry.RawSize;
+		delete read;
+		Reads.Remove(key);
+	}
+	else
+	{
+		// still in flight, deleted by PublishReads once done
+		read->bOrphan = true;
+	}
+}
+
+void SubstanceCache::SnapshotKeys(FGraphInstance* graph)
+{
+	const bool bCacheable = NULL != graph->ParentInstance &&
+		graph->ParentInstance->bCooked &&
+		graph->ParentInstance->Parent->ShouldCacheOutput();
+
+	// hashed once per push, by the first dirty output, the outputs keys
+	// derive from it
+	FSHAHash graphKey;
+	bool bHashed = false;
+	bool bKeyed = false;
+
+	for (auto itOut = graph->Outputs.itfront(); itOut; ++itOut)
+	{
+		output_inst_t* output = &(*itOut);
+
+		if (!output->bIsEnabled || !output->bIsDirty)
+		{
+			continue;
+		}
+
+		if (!bHashed)
+		{
+			bKeyed = bCacheable && GetGraphKey(graph, graphKey);
+			bHashed = true;
+		}
+
+		if (bKeyed)
+		{
+			GetOutputKey(graphKey, output, OutputKeys.FindOrAdd(output));
+		}
+		else
+		{
+			OutputKeys.Remove(output);
+		}
+	}
+}
+
+void SubstanceCache::ForgetOutput(const output_inst_t* output)
+{
+	// not created at exit only for this
+	if (SbsCache.IsValid())
+	{
+		SbsCache->OutputKeys.Remove(output);
+	}
+}
+
+void SubstanceCache::CacheOutput(output_inst_t* output, const SubstanceTexture& result)
+{
+	const int64 maxQueuedWriteBytes = 256 * 1024 * 1024;
+
+	// not the state of the inputs at publish time, they may have changed
+	// while rendering
+	FSHAHash outputKey;
+	if (!OutputKeys.RemoveAndCopyValue(output, outputKey) || !OpenPack())
+	{
+		return;
+	}
+
+	MergeWrittenEntries();
+
+	// content-addressed: an existing or queued entry already holds this result
+	if (NULL != Entries.Find(outputKey) || QueuedWriteKeys.Contains(outputKey))
+	{
+		return;
+	}
+
+	// startup only bound: full packs are compacted when opened at next
+	// start, not during the session (reads in flight use the offsets)
+	const int64 maxSize = (int64)GetDefault<USubstanceSettings>()->CacheMaxSizeMb * 1024 * 1024;
+	int64 packEnd = 0;
+	{
+		FScopeLock ScopeLock(&PackLock);
+		packEnd = PackEnd;
+	}
+
+	if (maxSize > 0 && packEnd >= maxSize)
+	{
+		if (!bPackFull)
+		{
+			UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache is full (%d MB), new entries are not cached until next start"),
+				GetDefault<USubstanceSettings>()->CacheMaxSizeMb);
+			bPackFull = true;
+		}
+
+		return;
+	}
+
+	EPixelFormat pixelFormat = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)result.pixelFormat);
+	const int64 size = CalcTextureSize(result.level0Width, result.level0Height, pixelFormat, result.mipmapCount);
+
+	bool bSchedule = false;
+	{
+		FScopeLock ScopeLock(&WriteLock);
+
+		// the writer is behind, drop the result rather than wait for it
+		if (QueuedWriteBytes + size > maxQueuedWriteBytes)
+		{
+			UE_LOG(LogSubstanceCache, Verbose, TEXT("Substance cache write queue full, output not cached"));
+			return;
+		}
+
+		// the render result is released after upload, the writer owns a copy
+		FPendingWrite* write = new FPendingWrite;
+		write->Key = outputKey;
+		write->Result = result;
+		write->Result.buffer = FMemory::Malloc(size);
+		write->Size = size;
+		write->Compression = GetCompressionFlags(result.pixelFormat);
+
+		FMemory::Memcpy(write->Result.buffer, result.buffer, size);
+
+		WriteQueue.Add(write);
+		QueuedWriteBytes += size;
+
+		if (!bWriterScheduled)
+		{
+			bWriterScheduled = true;
+			WriterIdleEvent->Reset();
+			bSchedule = true;
+		}
+	}
+
+	QueuedWriteKeys.Add(outputKey);
+
+	if (bSchedule)
+	{
+		if (GThreadPool != NULL)
+		{
+			GThreadPool->AddQueuedWork(Writer);
+		}
+		else
+		{
+			Writer->DoThreadedWork();
+		}
+	}
+}
+
+void SubstanceCache::DrainWrites()
+{
+	for (;;)
+	{
+		FPendingWrite* write = NULL;
+		{
+			FScopeLock ScopeLock(&WriteLock);
+
+			if (WriteQueue.Num() == 0)
+			{
+				bWriterScheduled = false;
+				WriterIdleEvent->Trigger();
+				return;
+			}
+
+			write = WriteQueue[0];
+			WriteQueue.RemoveAt(0);
+		}
+
+		WriteEntry(*write);
+
+		{
+			FScopeLock ScopeLock(&WriteLock);
+			QueuedWriteBytes -= write->Size;
+		}
+
+		FMemory::Free(write->Result.buffer);
+		delete write;
+	}
+}
+
+void SubstanceCache::FlushWrites()
+{
+	bool bScheduled = false;
+	{
+		FScopeLock ScopeLock(&WriteLock);
+		bScheduled = bWriterScheduled;
+	}
+
+	if (bScheduled)
+	{
+		// not started yet, written inline
+		if (GThreadPool != NULL && GThreadPool->RetractQueuedWork(Writer))
+		{
+			Writer->DoThreadedWork();
+		}
+
+		WriterIdleEvent->Wait();
+	}
+
+	MergeWrittenEntries();
+}
+
+void SubstanceCache::MergeWrittenEntries()
+{
+	FScopeLock ScopeLock(&PackLock);
+
+	for (int32 idx = 0; idx < WrittenEntries.Num(); ++idx)
+	{
+		Entries.Add(WrittenEntries[idx].Key, WrittenEntries[idx].Value);
+	}
+
+	for (int32 idx = 0; idx < DoneWriteKeys.Num(); ++idx)
+	{
+		QueuedWriteKeys.Remove(DoneWriteKeys[idx]);
+	}
+
+	WrittenEntries.Empty();
+	DoneWriteKeys.Empty();
+}
+
+bool SubstanceCache::GetGraphKey(FGraphInstance* graph, FSHAHash& outKey)
+{
+	if (NULL == graph || NULL == graph->Desc || NULL == graph->Desc->Parent)
+	{
+		return false;
+	}
+
+	// sbsar assembly, the package may have released its link data
+	const FPackage* package = graph->Desc->Parent;
+	std::shared_ptr<Details::LinkData> linkData = package->getLinkData();
+
+	if (linkData.get() != NULL)
+	{
+		FSHA1 packageHash;
+		FSHAHash packageKey;
+
+		linkData->hash(packageHash);
+		packageHash.Final();
+		packageHash.GetHash(packageKey.Hash);
+
+		PackageKeys.Add(package->Guid, packageKey);
+	}
+
+	const FSHAHash* packageKey = PackageKeys.Find(package->Guid);
+
+	if (NULL == packageKey)
+	{
+		return false;
+	}
+
+	FSHA1 hashState;
+
+	hashState.Update(packageKey->Hash, sizeof(packageKey->Hash));
+
+	// graph
+	const FString& url = graph->Desc->PackageUrl;
+	hashState.Update((const uint8*)*url, url.Len() * sizeof(TCHAR));
+
+	// inputs state, image inputs by content
+	TArray<input_inst_t*> inputs;
+
+	auto itInput = graph->Inputs.itfront();
+	while (itInput)
+	{
+		inputs.Add((*itInput).Get());
+		itInput++;
+	}
+
+	inputs.Sort(FInputUidLess());
+
+	for (int32 idx = 0; idx < inputs.Num(); ++idx)
+	{
+		const input_inst_t* input = inputs[idx];
+
+		hashState.Update((const uint8*)&input->Uid, sizeof(input->Uid));
+		hashState.Update((const uint8*)&input->Type, sizeof(input->Type));
+
+		if (input->IsNumerical())
+		{
+			const FNumericalInputInstanceBase* numInput = (const FNumericalInputInstanceBase*)input;
+			hashState.Update((const uint8*)numInput->getRawData(), numInput->getRawSize());
+		}
+		else
+		{
+			HashImage(hashState, ((const FImageInputInstance*)input)->GetImage());
+		}
+	}
+
+	hashState.Final();
+	hashState.GetHash(outKey.Hash);
+
+	return true;
+}
+
+void SubstanceCache::GetOutputKey(const FSHAHash& graphKey, const output_inst_t* output, FSHAHash& outKey) const
+{
+	FSHA1 hashState;
+
+	hashState.Update(graphKey.Hash, sizeof(graphKey.Hash));
+	hashState.Update((const uint8*)&output->Uid, sizeof(output->Uid));
+	hashState.Update((const uint8*)&output->Format, sizeof(output->Format));
+	hashState.Final();
+	hashState.GetHash(outKey.Hash);
+}
+
+void SubstanceCache::SerializeEntry(FArchive& Ar, FSHAHash& key, FEntry& entry)
+{
+	Ar.Serialize(key.Hash, sizeof(key.Hash));
+	Ar << entry.Size;
+	Ar << entry.RawSize;
+	Ar << entry.Compression;
+	Ar << entry.Width;
+	Ar << entry.Height;
+	Ar << entry.PixelFormat;
+	Ar << entry.ChannelsOrder;
+	Ar << entry.MipmapCount;
+	Ar << entry.LastAccess;
+}
+
+bool SubstanceCache::OpenPack()
+{
+	if (bPackOpened)
+	{
+		return Pack != NULL;
+	}
+
+	bPackOpened = true;
+
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString path = GetPackPath();
+
+	platformFile.CreateDirectoryTree(*FPaths::GetPath(path));
+
+	Pack = platformFile.OpenWrite(*path, true, true);
+
+	if (NULL == Pack)
+	{
+		UE_LOG(LogSubstanceCache, Warning, TEXT("Unable to open Substance cache %s"), *path);
+		return false;
+	}
+
+	const int64 packSize = Pack->Size();
+
+	uint32 magic = 0;
+	uint32 version = 0;
+
+	TArray<uint8> header;
+
+	if (packSize >= HEADER_SIZE && ReadAt(Pack, 0, header, HEADER_SIZE))
+	{
+		FMemoryReader Ar(header);
+		Ar << magic;
+		Ar << version;
+	}
+
+	if (magic != PACK_MAGIC || version != SUBSTANCECACHE_VERSION)
+	{
+		if (packSize > 0)
+		{
+			UE_LOG(LogSubstanceCache, Warning, TEXT("Out of date Substance cache, will regenerate"));
+		}
+
+		// first open of the pack: the entries of the previous layout are dropped
+		DeleteLegacyEntries(FPaths::GetPath(path));
+
+		delete Pack;
+		Pack = CreatePack(platformFile, path);
+		PackEnd = HEADER_SIZE;
+
+		return Pack != NULL;
+	}
+
+	if (!ReadIndex(packSize))
+	{
+		RecoverIndex(packSize);
+	}
+
+	// evict the least recently used entries of the previous sessions
+	const int64 maxSize = (int64)GetDefault<USubstanceSettings>()->CacheMaxSizeMb * 1024 * 1024;
+
+	if (Pack != NULL && maxSize > 0 && PackEnd > maxSize)
+	{
+		Compact(maxSize - maxSize / 4);
+	}
+
+	if (Pack != NULL)
+	{
+		SET_MEMORY_STAT(STAT_SubstanceCacheSize, PackEnd);
+	}
+
+	return Pack != NULL;
+}
+
+void SubstanceCache::Compact(int64 targetSize)
+{
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString path = GetPackPath();
+	const FString compactPath = path + TEXT(".tmp");
+
+	IFileHandle* compactPack = CreatePack(platformFile, compactPath);
+
+	if (NULL == compactPack)
+	{
+		return;
+	}
+
+	TArray< TPair<FSHAHash, FEntry> > sortedEntries;
+	sortedEntries.Reserve(Entries.Num());
+
+	for (auto itEntry = Entries.CreateConstIterator(); itEntry; ++itEntry)
+	{
+		sortedEntries.Add(TPair<FSHAHash, FEntry>(itEntry.Key(), itEntry.Value()));
+	}
+
+	sortedEntries.Sort(FLastAccessGreater());
+
+	// copy the most recently used entries while they fit
+	TMap<FSHAHash, FEntry> keptEntries;
+	TArray<uint8> payload;
+	int64 compactEnd = HEADER_SIZE;
+	bool bFailed = false;
+
+	for (int32 idx = 0; idx < sortedEntries.Num() && !bFailed; ++idx)
+	{
+		FEntry entry = sortedEntries[idx].Value;
+		const int64 recordSize = HEADER_SIZE + AlignOffset(entry.Size);
+
+		if (compactEnd + recordSize > targetSize)
+		{
+			break;
+		}
+
+		if (!ReadAt(Pack, entry.Offset, payload, entry.Size))
+		{
+			bFailed = true;
+			break;
+		}
+
+		entry.Offset = compactEnd + HEADER_SIZE;
+
+		bFailed = !AppendRecord(compactPack, sortedEntries[idx].Key, entry, payload.GetData());
+		compactEnd += recordSize;
+
+		keptEntries.Add(sortedEntries[idx].Key, entry);
+	}
+
+	if (bFailed)
+	{
+		UE_LOG(LogSubstanceCache, Warning, TEXT("Unable to compact the Substance cache"));
+		delete compactPack;
+		platformFile.DeleteFile(*compactPath);
+		return;
+	}
+
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache compacted, %d of %d entries evicted, %u KB freed"),
+		Entries.Num() - keptEntries.Num(),
+		Entries.Num(),
+		(uint32)((PackEnd - compactEnd) / 1024));
+
+	// the read handles are on the pack about to be replaced
+	CloseReadHandles();
+
+	// the compacted pack is complete with its index before replacing the pack
+	IFileHandle* previousPack = Pack;
+	const int64 previousEnd = PackEnd;
+	const bool bPreviousIndexDirty = bIndexDirty;
+	TMap<FSHAHash, FEntry> previousEntries = Entries;
+
+	Pack = compactPack;
+	PackEnd = compactEnd;
+	Entries = keptEntries;
+	bIndexDirty = true;
+
+	WriteIndex();
+
+	delete Pack;
+	delete previousPack;
+	Pack = NULL;
+
+	// the previous pack is moved aside, not deleted: restored if the
+	// compacted one cannot take its place
+	const FString previousPath = path + TEXT(".old");
+	platformFile.DeleteFile(*previousPath);
+
+	bool bReplaced = false;
+	bool bRestored = false;
+
+	if (platformFile.MoveFile(*previousPath, *path))
+	{
+		bReplaced = platformFile.MoveFile(*path, *compactPath);
+		bRestored = !bReplaced && platformFile.MoveFile(*path, *previousPath);
+	}
+	else
+	{
+		// still in place
+		bRestored = true;
+	}
+
+	platformFile.DeleteFile(*compactPath);
+
+	if (bReplaced)
+	{
+		platformFile.DeleteFile(*previousPath);
+	}
+	else if (bRestored)
+	{
+		UE_LOG(LogSubstanceCache, Warning, TEXT("Unable to replace the Substance cache %s, kept uncompacted"), *path);
+		PackEnd = previousEnd;
+		Entries = previousEntries;
+		bIndexDirty = bPreviousIndexDirty;
+	}
+
+	Pack = (bReplaced || bRestored) ? platformFile.OpenWrite(*path, true, true) : NULL;
+
+	if (NULL == Pack)
+	{
+		// both packs lost: start over w/ an empty one
+		UE_LOG(LogSubstanceCache, Warning, TEXT("Unable to reopen Substance cache %s, will regenerate"), *path);
+		Entries.Empty();
+		PackEnd = HEADER_SIZE;
+		bIndexDirty = false;
+		Pack = CreatePack(platformFile, path);
+	}
+}
+
+bool SubstanceCache::ReadIndex(int64 packSize)
+{
+	if (packSize < 2 * HEADER_SIZE + FOOTER_SIZE)
+	{
+		return false;
+	}
+
+	TArray<uint8> footer;
+
+	if (!ReadAt(Pack, packSize - FOOTER_SIZE, footer, FOOTER_SIZE))
+	{
+		return false;
+	}
+
+	int64 indexOffset = 0;
+	uint32 count = 0;
+	uint32 magic = 0;
+	{
+		FMemoryReader Ar(footer);
+		Ar << indexOffset;
+		Ar << count;
+		Ar << magic;
+	}
+
+	const int64 bodyOffset = indexOffset + HEADER_SIZE;
+	const int64 bodySize = packSize - FOOTER_SIZE - bodyOffset;
+
+	if (magic != INDEX_MAGIC || indexOffset < HEADER_SIZE || bodySize < 0)
+	{
+		return false;
+	}
+
+	TArray<uint8> body;
+
+	if (!ReadAt(Pack, bodyOffset, body, bodySize))
+	{
+		return false;
+	}
+
+	FMemoryReader Ar(body);
+
+	for (uint32 idx = 0; idx < count && !Ar.IsError(); ++idx)
+	{
+		FSHAHash key;
+		FEntry entry;
+
+		SerializeEntry(Ar, key, entry);
+		Ar << entry.Offset;
+
+		if (entry.Offset + entry.Size > indexOffset)
+		{
+			Ar.SetError();
+			break;
+		}
+
+		Entries.Add(key, entry);
+	}
+
+	if (Ar.IsError())
+	{
+		Entries.Empty();
+		return false;
+	}
+
+	PackEnd = AlignOffset(packSize);
+
+	return true;
+}
+
+void SubstanceCache::RecoverIndex(int64 packSize)
+{
+	UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache was not closed, rebuilding its index"));
+
+	int64 offset = HEADER_SIZE;
+	TArray<uint8> header;
+
+	while (offset + HEADER_SIZE <= packSize && ReadAt(Pack, offset, header, HEADER_SIZE))
+	{
+		FMemoryReader Ar(header);
+
+		uint32 magic = 0;
+		Ar << magic;
+
+		if (RECORD_MAGIC == magic)
+		{
+			FSHAHash key;
+			FEntry entry;
+
+			SerializeEntry(Ar, key, entry);
+			entry.Offset = offset + HEADER_SIZE;
+
+			// truncated record
+			if (entry.Size < 0 || entry.Offset + entry.Size > packSize)
+			{
+				break;
+			}
+
+			Entries.Add(key, entry);
+			offset = AlignOffset(entry.Offset + entry.Size);
+		}
+		else if (INDEX_MAGIC == magic)
+		{
+			// previous index, superseded by the records that follow it
+			int64 bodySize = 0;
+			Ar << bodySize;
+
+			offset = AlignOffset(offset + HEADER_SIZE + bodySize + FOOTER_SIZE);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	// a record may have been cut in the middle
+	if (!PadToAlignment(Pack))
+	{
+		delete Pack;
+		Pack = NULL;
+	}
+
+	PackEnd = AlignOffset(packSize);
+	bIndexDirty = true;
+}
+
+void SubstanceCache::WriteIndex()
+{
+	if (!bIndexDirty)
+	{
+		return;
+	}
+
+	TArray<uint8> body;
+	{
+		FMemoryWriter Ar(body);
+
+		for (auto itEntry = Entries.CreateIterator(); itEntry; ++itEntry)
+		{
+			FSHAHash key = itEntry.Key();
+			FEntry entry = itEntry.Value();
+
+			SerializeEntry(Ar, key, entry);
+			Ar << entry.Offset;
+		}
+	}
+
+	int64 indexOffset = PackEnd;
+	int64 bodySize = body.Num();
+	uint32 count = Entries.Num();
+	uint32 magic = INDEX_MAGIC;
+
+	// header, body, then the footer at the very end of the aligned block
+	const int64 blockSize = AlignOffset(HEADER_SIZE + bodySize + FOOTER_SIZE);
+
+	TArray<uint8> block;
+	{
+		FMemoryWriter Ar(block);
+		Ar << magic;
+		Ar << bodySize;
+	}
+
+	block.AddZeroed((int32)HEADER_SIZE - block.Num());
+	block.Append(body);
+	block.AddZeroed((int32)(blockSize - FOOTER_SIZE) - block.Num());
+	{
+		FMemoryWriter Ar(block, false, true);
+		Ar << indexOffset;
+		Ar << count;
+		Ar << magic;
+	}
+
+	if (AppendAligned(Pack, block.GetData(), block.Num()))
+	{
+		PackEnd += blockSize;
+		bIndexDirty = false;
+	}
+}
+
+IFileHandle* SubstanceCache::AcquireReadHandle()
+{
+	{
+		FScopeLock ScopeLock(&ReadHandlesLock);
+
+		if (bSharedReads)
+		{
+			return NULL;
+		}
+
+		if (ReadHandles.Num() > 0)
+		{
+			return ReadHandles.Pop(false);
+		}
+	}
+
+	IFileHandle* reader = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*GetPackPath());
+
+	if (NULL == reader)
+	{
+		// the platform does not share the pack opened for appending
+		FScopeLock ScopeLock(&ReadHandlesLock);
+
+		if (!bSharedReads)
+		{
+			UE_LOG(LogSubstanceCache, Log, TEXT("Substance cache reads share the pack handle"));
+			bSharedReads = true;
+		}
+	}
+
+	return reader;
+}
+
+void SubstanceCache::ReleaseReadHandle(IFileHandle* reader)
+{
+	FScopeLock ScopeLock(&ReadHandlesLock);
+	ReadHandles.Add(reader);
+}
+
+void SubstanceCache::CloseReadHandles()
+{
+	FScopeLock ScopeLock(&ReadHandlesLock);
+
+	for (int32 idx = 0; idx < ReadHandles.Num(); ++idx)
+	{
+		delete ReadHandles[idx];
+	}
+
+	ReadHandles.Empty();
+}
+
+bool SubstanceCache::ReadEntry(const FEntry& entry, SubstanceTexture& result)
+{
+	check(result.buffer == NULL);
+	result.buffer = FMemory::Malloc(entry.RawSize);
+
+	const bool bCompressed = entry.Compression != COMPRESS_None;
+	TArray<uint8> compressed;
+
+	if (bCompressed)
+	{
+		compressed.AddUninitialized((int32)entry.Size);
+	}
+
+	uint8* payload = bCompressed ? compressed.GetData() : (uint8*)result.buffer;
+
+	bool bRead = false;
+	IFileHandle* reader = AcquireReadHandle();
+
+	if (reader != NULL)
+	{
+		// own handle: reads run in parallel, not behind the appends
+		bRead = reader->Seek(entry.Offset) && reader->Read(payload, entry.Size);
+		ReleaseReadHandle(reader);
+	}
+	else
+	{
+		FScopeLock ScopeLock(&PackLock);
+		bRead = Pack != NULL && Pack->Seek(entry.Offset) && Pack->Read(payload, entry.Size);
+	}
+
+	// decompressed out of the lock, the other workers keep reading
+	if (bRead && bCompressed)
+	{
+		bRead = FCompression::UncompressMemory(
+			(ECompressionFlags)entry.Compression,
+			result.buffer,
+			(int32)entry.RawSize,
+			compressed.GetData(),
+			(int32)entry.Size);
+	}
+
+	if (!bRead)
+	{
+		FMemory::Free(result.buffer);
+		result.buffer = NULL;
+		return false;
+	}
+
+	result.level0Width = entry.Width;
+	result.level0Height = entry.Height;
+	result.pixelFormat = entry.PixelFormat;
+	result.channelsOrder = entry.ChannelsOrder;
+	result.mipmapCount = entry.MipmapCount;
+
+	return true;
+}
+
+void SubstanceCache::WriteEntry(const FPendingWrite& write)
+{
+	const SubstanceTexture& result = write.Result;
+
+	FEntry entry;
+	entry.RawSize = write.Size;
+	entry.Size = entry.RawSize;
+	entry.Compression = COMPRESS_None;
+	entry.Width = result.level0Width;
+	entry.Height = result.level0Height;
+	entry.PixelFormat = result.pixelFormat;
+	entry.ChannelsOrder = result.channelsOrder;
+	entry.MipmapCount = result.mipmapCount;
+	entry.LastAccess = FDateTime::UtcNow().ToUnixTimestamp();
+
+	const uint8* payload = (const uint8*)result.buffer;
+
+	// kept compressed if it saves at least 1/8th: the compression fails
+	// when the output does not fit the buffer
+	TArray<uint8> compressed;
+
+	if (write.Compression != COMPRESS_None)
+	{
+		int32 compressedSize = (int32)(entry.RawSize - entry.RawSize / 8);
+		compressed.AddUninitialized(compressedSize);
+
+		if (FCompression::CompressMemory(write.Compression, compressed.GetData(), compressedSize, result.buffer, (int32)entry.RawSize))
+		{
+			payload = compressed.GetData();
+			entry.Size = compressedSize;
+			entry.Compression = (uint8)write.Compression;
+		}
+	}
+
+	FScopeLock ScopeLock(&PackLock);
+
+	DoneWriteKeys.Add(write.Key);
+
+	if (NULL == Pack)
+	{
+		return;
+	}
+
+	entry.Offset = PackEnd + HEADER_SIZE;
+
+	if (AppendRecord(Pack, write.Key, entry, payload))
+	{
+		WrittenEntries.Add(TPair<FSHAHash, FEntry>(write.Key, entry));
+		PackEnd = AlignOffset(entry.Offset + entry.Size);
+		bIndexDirty = true;
+
+		TotalBytesWritten += entry.Size;
+		INC_MEMORY_STAT_BY(STAT_SubstanceCacheBytesWritten, entry.Size);
+		SET_MEMORY_STAT(STAT_SubstanceCacheSize, PackEnd);
+	}
+	else
+	{
+		// the pack end is unknown, stop appending
+		UE_LOG(LogSubstanceCache, Warning, TEXT("Unable to write to the Substance cache"));
+		delete Pack;
+		Pack = NULL;
+	}
+}
+
+bool SubstanceCache::AppendRecord(IFileHandle* pack, const FSHAHash& key, const FEntry& entry, const uint8* payload)
+{
+	FSHAHash recordKey = key;
+	FEntry recordEntry = entry;
+
+	TArray<uint8> header;
+	{
+		FMemoryWriter Ar(header);
+		uint32 magic = RECORD_MAGIC;
+		Ar << magic;
+		SerializeEntry(Ar, recordKey, recordEntry);
+	}
+
+	header.AddZeroed((int32)HEADER_SIZE - header.Num());
+
+	return AppendAligned(pack, header.GetData(), header.Num()) &&
+		AppendAligned(pack, payload, entry.Size);
+}
@@ -5,12 +5,35 @@
 #pragma once
 
 #include "substance_public.h"
+#include "SecureHash.h"
 
 class FArchive;
+class IFileHandle;
 class USubstanceTexture2D;
 
 namespace Substance
 {
+	//! @brief Disk cache of the outputs render results
+	//! The entries are stored in a single pack file, Saved/Substance/Cache.pack,
+	//! opened once. Its index is kept in memory: lookups do not touch the disk
+	//! and reading an entry is a single seek and read.
+	//! Pack layout, only ever appended to:
+	//!		- records: a header then the payload, aligned on ALIGNMENT bytes,
+	//!		  raw pixels payloads are deflated (FCompression)
+	//!		- index: a copy of all the records headers with their offsets
+	//!		- footer: the offset of the index, written last
+	//! A pack not ending with a valid footer (crash before Shutdown) is
+	//! recovered by walking the records headers.
+	//! The pack is bounded by the CacheMaxSizeMb setting at startup only:
+	//! when opened above it, the least recently used entries are evicted by
+	//! a compaction. During a session the pack is not compacted (the reads
+	//! in flight use the entries offsets): new entries are not written once
+	//! it is full, until next start.
+	//! Entries are read on the worker thread pool, in parallel on their own
+	//! read handles: the game thread only issues the reads and publishes
+	//! the textures once the data is there.
+	//! Entries are written behind by a single job on the thread pool, from
+	//! a bounded queue of copies of the results, flushed at Shutdown.
 	class SubstanceCache
 	{
 	public:
@@ -23,23 +46,275 @@ namespace Substance
 			return SbsCache;
 		}
 
+		//! @brief Write the index of the pack and close it
 		static void Shutdown()
 		{
-			if (!SbsCache.IsValid())
+			if (SbsCache.IsValid())
 			{
 				SbsCache.Reset();
 			}
 		}
 
+		~SubstanceCache();
+
 		bool CanReadFromCache(FGraphInstance* graph);
 
+		//! @brief Read the entries of a graph instance and update its outputs
+		//! @note Blocking, waits for the reads already issued by Prefetch
 		bool ReadFromCache(FGraphInstance* graph);
 
+		//! @brief Read the entries of a graph instance in the background,
+		//! its outputs are updated by PublishReads once all are read
+		//! @return Return false if some enabled outputs have no entry
+		bool ReadFromCacheAsync(FGraphInstance* graph);
+
+		//! @brief Start reading the entries of a graph instance expected to
+		//! be read soon (ReadFromCache or ReadFromCacheAsync)
+		//! @note Bounded, prefetching stops above a memory budget
+		void Prefetch(FGraphInstance* graph);
+
+		//! @brief Drop the prefetched entries no graph instance asked for
+		//! @note Called once the loading queues are processed
+		void DropPrefetches();
+
+		//! @brief Update the outputs of the graph instances whose reads are done
+		//! @param completedGraphs Graph instances updated from the cache
+		//! @param failedGraphs Graph instances whose entries could not be read
+		void PublishReads(
+			Substance::List<graph_inst_t*>& completedGraphs,
+			Substance::List<graph_inst_t*>& failedGraphs);
+
+		//! @brief Forget the pending reads of a graph instance
+		//! @return Return true if some reads were pending
+		bool CancelReads(FGraphInstance* graph);
+
+		//! @brief Return true if a graph instance waits for its reads
+		bool IsReading(FGraphInstance* graph) const;
+
+		//! @brief Keep the keys of the current state of the dirty outputs of
+		//! a graph instance about to be rendered, their results are cached
+		//! under them by CacheOutput
+		//! @note Called when the graph instance is pushed to the renderer,
+		//!		before its outputs are queued. The graph is hashed once.
+		void SnapshotKeys(FGraphInstance* graph);
+
+		//! @brief Forget the key of a deleted output
+		static void ForgetOutput(const output_inst_t* output);
+
+		//! @brief Queue the result of an output for writing, under the key
+		//! snapshot when it was pushed
 		void CacheOutput(output_inst_t* Output, const SubstanceTexture& result);
 
+		//! @brief Log the size and the counters of the cache
+		//! @note Substance.CacheStats console command
+		static void LogStats();
+
 	private:
-		FString GetPathForGuid(const FGuid& guid) const;
-		bool SerializeTexture(FArchive& Ar, SubstanceTexture& result) const;
+		//! @brief Location of a render result in the pack
+		struct FEntry
+		{
+			//! @brief Offset of the payload, aligned
+			int64 Offset;
+
+			//! @brief Size of the payload in bytes, as stored
+			int64 Size;
+
+			//! @brief Size of the render result in bytes
+			int64 RawSize;
+
+			//! @brief Compression of the payload, ECompressionFlags
+			uint8 Compression;
+
+			//! @brief Time of the last read or write, unix timestamp
+			int64 LastAccess;
+
+			uint16 Width;
+			uint16 Height;
+			uint8 PixelFormat;
+			uint8 ChannelsOrder;
+			uint8 MipmapCount;
+		};
+
+		//! @brief Background read of an entry, shared by the graph instances
+		//! with the same entry, see SubstanceCache.cpp
+		struct FRead;
+
+		//! @brief Result waiting to be written, see SubstanceCache.cpp
+		struct FPendingWrite;
+
+		//! @brief Background writer job, drains WriteQueue
+		struct FWriter;
+
+		//! @brief Graph instance waiting for its reads before publishing
+		struct FPendingGraph
+		{
+			graph_inst_t* Graph;
+
+			TArray<FSHAHash> Keys;
+		};
+
+		SubstanceCache();
+
+		//! @brief Serialize the part of an entry stored in a record header
+		static void SerializeEntry(FArchive& Ar, FSHAHash& key, FEntry& entry);
+
+		//! @brief Compute the key of the current state of a graph instance:
+		//! sbsar assembly, graph url and values of all the inputs
+		//! @return Return false if the graph cannot be keyed (link data
+		//!		never loaded)
+		bool GetGraphKey(FGraphInstance* graph, FSHAHash& outKey);
+
+		//! @brief Compute the key of an output entry from the graph key,
+		//! the output uid and the output format
+		void GetOutputKey(const FSHAHash& graphKey, const output_inst_t* output, FSHAHash& outKey) const;
+
+		//! @brief Open the pack and load its index, once
+		//! @return Return false if the pack cannot be opened
+		bool OpenPack();
+
+		//! @brief Load the index from the footer, false if not valid
+		bool ReadIndex(int64 packSize);
+
+		//! @brief Rebuild the index from the records headers
+		void RecoverIndex(int64 packSize);
+
+		//! @brief Append the index and the footer to the pack
+		void WriteIndex();
+
+		//! @brief Rewrite the pack with the most recently used entries that
+		//! fit the target size, the others are evicted
+		void Compact(int64 targetSize);
+
+		//! @brief Append a record (header and payload) to a pack
+		bool AppendRecord(IFileHandle* pack, const FSHAHash& key, const FEntry& entry, const uint8* payload);
+
+		//! @brief Count a graph instance lookup in the stats
+		void CountLookup(bool bHit);
+
+		//! @brief Read the payload of an entry
+		//! @post result.buffer is allocated with FMemory::Malloc on success
+		//! @note Called from worker threads
+		bool ReadEntry(const FEntry& entry, SubstanceTexture& result);
+
+		//! @brief Take a read only handle on the pack, opened if none is free
+		//! @return Return NULL if the pack cannot be opened twice: reads go
+		//!		through the shared handle (PackLock)
+		//! @note Called from worker threads
+		IFileHandle* AcquireReadHandle();
+
+		//! @brief Give back a read handle for the next reads
+		void ReleaseReadHandle(IFileHandle* reader);
+
+		//! @brief Close the free read handles
+		//! @pre No read in flight
+		void CloseReadHandles();
+
+		//! @brief Compute the keys of the enabled outputs of a graph instance
+		//! @return Return false if some of them have no entry
+		bool GetEntriesKeys(FGraphInstance* graph, TArray<FSHAHash>& outKeys);
+
+		//! @brief Return the read of an entry, issued if not already in flight
+		FRead* IssueRead(const FSHAHash& key);
+
+		//! @brief Release a claim on a read, deleted when done and unclaimed
+		void ReleaseRead(const FSHAHash& key);
+
+		//! @brief Compress and append a record to the pack
+		//! @note Called from the background writer
+		void WriteEntry(const FPendingWrite& write);
+
+		//! @brief Write the queued results until the queue is empty
+		//! @note Called from the background writer
+		void DrainWrites();
+
+		//! @brief Wait for the queued results to be written
+		void FlushWrites();
+
+		//! @brief Add the entries written in the background to the index
+		void MergeWrittenEntries();
+
+		//! @brief The pack, opened for reading and appending
+		IFileHandle* Pack;
+
+		//! @brief Serializes the appends to the pack from the writer, also
+		//! protects PackEnd and the written entries. The reads use their
+		//! own handles, the pack handle only if the platform cannot open it
+		//! twice.
+		FCriticalSection PackLock;
+
+		//! @brief Free read only handles on the pack, one per concurrent read
+		TArray<IFileHandle*> ReadHandles;
+
+		//! @brief Protects ReadHandles and bSharedReads
+		FCriticalSection ReadHandlesLock;
+
+		//! @brief Pack index, in memory
+		TMap<FSHAHash, FEntry> Entries;
+
+		//! @brief Reads in flight or not yet published, by entry key
+		TMap<FSHAHash, FRead*> Reads;
+
+		//! @brief Size of the payloads of Reads
+		int64 ReadsBytes;
+
+		//! @brief Graph instances waiting for their reads
+		TArray<FPendingGraph> PendingGraphs;
+
+		//! @brief Keys of the states of the last pushed renders, by output,
+		//! the render results are from the last push (grabResult)
+		TMap<const output_inst_t*, FSHAHash> OutputKeys;
+
+		//! @brief Hash of the link data of the packages, by package guid,
+		//! kept when the link data is released
+		TMap<FGuid, FSHAHash> PackageKeys;
+
+		//! @brief Offset of the next record, aligned
+		int64 PackEnd;
+
+		//! @brief Protects WriteQueue, QueuedWriteBytes and bWriterScheduled
+		FCriticalSection WriteLock;
+
+		//! @brief Results to write, in order
+		TArray<FPendingWrite*> WriteQueue;
+
+		//! @brief Size of the results of WriteQueue
+		int64 QueuedWriteBytes;
+
+		//! @brief The writer job is queued or running
+		bool bWriterScheduled;
+
+		FWriter* Writer;
+
+		//! @brief Triggered when the writer job is done
+		FEvent* WriterIdleEvent;
+
+		//! @brief Keys queued and not yet merged, coalesces the writes
+		TSet<FSHAHash> QueuedWriteKeys;
+
+		//! @brief Entries written, to merge in the index (PackLock)
+		TArray< TPair<FSHAHash, FEntry> > WrittenEntries;
+
+		//! @brief Keys processed by the writer, failed ones included (PackLock)
+		TArray<FSHAHash> DoneWriteKeys;
+
+		//! @brief Session counters, see LogStats
+		uint32 Hits;
+		uint32 Misses;
+		uint64 TotalBytesRead;
+		uint64 TotalBytesWritten;
+
+		//! @brief Records were appended or read since the last index
+		bool bIndexDirty;
+
+		//! @brief OpenPack was already called
+		bool bPackOpened;
+
+		//! @brief The pack reached CacheMaxSizeMb, writes are skipped
+		bool bPackFull;
+
+		//! @brief The pack cannot be opened for reading while opened for
+		//! appending, reads go through the pack handle
+		bool bSharedReads;
 
 		static TSharedPtr<SubstanceCache> SbsCache;
 	};
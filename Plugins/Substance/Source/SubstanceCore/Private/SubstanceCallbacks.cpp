@@ -9,8 +9,13 @@
 #include "SubstanceFGraph.h"
 #include "SubstanceFOutput.h"
 
-Substance::List<output_inst_t*> Substance::RenderCallbacks::mOutputQueue;
-Substance::Details::Sync::mutex Substance::RenderCallbacks::mMutex;
+#include <limits>
+
+//! @brief Log2 of the computed outputs queue capacity
+#define SUBSTANCE_OUTPUT_QUEUE_CAPACITY_LOG2 14
+
+Substance::Details::OutputQueue Substance::RenderCallbacks::mOutputQueue(
+	SUBSTANCE_OUTPUT_QUEUE_CAPACITY_LOG2);
 
 
 void Substance::RenderCallbacks::outputComputed(
@@ -18,33 +23,31 @@ void Substance::RenderCallbacks::outputComputed(
 	const Substance::FGraphInstance* graph,
 	Substance::FOutputInstance* output)
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
-	mOutputQueue.AddUnique(output);
+	// Skipped if already queued
+	mOutputQueue.push(output);
 }
 
 
 Substance::List<Substance::FOutputInstance*> Substance::RenderCallbacks::getComputedOutputs(bool throttleOutputGrab)
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
 	Substance::List<Substance::FOutputInstance*> outputs;
 	
-	if (mOutputQueue.size())
-	{
-		if (throttleOutputGrab)
-		{
-			outputs.push(mOutputQueue.pop());
-		}
-		else
-		{
-			outputs = mOutputQueue;
-			mOutputQueue.Empty();
-		}
-	}
+	drainComputedOutputs(
+		outputs,
+		throttleOutputGrab ? 1 : std::numeric_limits<size_t>::max());
 	 
 	return outputs;
 }
 
 
+size_t Substance::RenderCallbacks::drainComputedOutputs(
+	Substance::List<output_inst_t*>& Outputs,
+	size_t MaxCount)
+{
+	return mOutputQueue.drain(Outputs,MaxCount);
+}
+
+
 bool Substance::RenderCallbacks::runRenderProcess(RenderFunction renderFunction, void* renderParams)
 {		
 	return false;
@@ -53,6 +56,5 @@ bool Substance::RenderCallbacks::runRenderProcess(RenderFunction renderFunction,
 
 void Substance::RenderCallbacks::clearComputedOutputs(output_inst_t* Output)
 {
-	Substance::Details::Sync::unique_lock slock(mMutex);
-	mOutputQueue.Remove(Output);
+	mOutputQueue.remove(Output);
 }
@@ -8,7 +8,7 @@
 
 #include "framework/callbacks.h"
 
-#include "framework/details/detailssync.h"
+#include "framework/details/detailsoutputqueue.h"
 
 namespace Substance
 {
@@ -28,6 +28,15 @@ public:
 
 	static Substance::List<output_inst_t*> getComputedOutputs(bool throttleOutputGrab=true);
 
+	//! @brief Pop computed outputs in batch
+	//! @param Outputs Array to append the computed outputs to
+	//! @param MaxCount Maximum count of outputs to pop
+	//! @return Return the count of outputs appended
+	//! @note Called from game thread only
+	static size_t drainComputedOutputs(
+		Substance::List<output_inst_t*>& Outputs,
+		size_t MaxCount);
+
 	static void clearComputedOutputs(output_inst_t*);
 
 	bool runRenderProcess(
@@ -36,12 +45,12 @@ public:
 
 	static bool isOutputQueueEmpty()
 	{
-		return mOutputQueue.size() == 0;
+		return mOutputQueue.isEmpty();
 	}
 
 protected:
-	static Substance::List<output_inst_t*> mOutputQueue;
-	static Substance::Details::Sync::mutex mMutex;
+	//! @brief Computed outputs, pushed by all renderers/workers render threads
+	static Substance::Details::OutputQueue mOutputQueue;
 };
 
 } // namespace Substance
@@ -0,0 +1,433 @@
+//! @file SubstanceCoreBenchmarks.cpp
+//! @brief Microbenchmarks of the Substance texture processing and disk cache, run from the console
+//! @date 20150320
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCoreHelpers.h"
+#include "SubstanceBlockCompression.h"
+
+#include "Paths.h"
+#include "PlatformFilemanager.h"
+
+#if !UE_BUILD_SHIPPING
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceBenchmarks, Log, All);
+
+namespace
+{
+	//! @brief Default iterations count of each measure
+	const int32 DefaultIterations = 20;
+
+	//! @brief Width and height of the benchmarked mips
+	const int32 BenchMipSize = 2048;
+
+	//! @brief Parse the iterations count argument, the default if none
+	int32 GetIterations(const TArray<FString>& Args)
+	{
+		return Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : DefaultIterations;
+	}
+
+	//! @brief Fill a buffer w/ reproducible pseudo random bytes
+	void FillRandom(TArray<uint8>& Buffer, int32 Seed)
+	{
+		FRandomStream Stream(Seed);
+
+		for (int32 Idx = 0; Idx < Buffer.Num(); ++Idx)
+		{
+			Buffer[Idx] = (uint8)Stream.RandHelper(256);
+		}
+	}
+
+	//! @brief Sequential read bandwidths of the storage classes projected by
+	//!	the cache read benchmark, in bytes per second
+	const double HddBandwidth = 120.0 * 1024.0 * 1024.0;
+	const double SsdBandwidth = 500.0 * 1024.0 * 1024.0;
+
+	//! @brief Compression of the cache entries payloads, see SubstanceCache.cpp
+	const ECompressionFlags CacheCompression = (ECompressionFlags)(COMPRESS_ZLIB | COMPRESS_BiasSpeed);
+
+	//! @brief Log the timing of a measure, w/ its throughput
+	void LogTiming(const TCHAR* Name, double BestSeconds, double TotalSeconds, int32 Iterations, SIZE_T Bytes)
+	{
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  %-12s best %8.3f ms, avg %8.3f ms, %7.2f GB/s"),
+			Name,
+			BestSeconds * 1000.0,
+			TotalSeconds * 1000.0 / Iterations,
+			(double)Bytes / BestSeconds / (1024.0 * 1024.0 * 1024.0));
+	}
+
+	//! @brief Scalar vs vectorized RGBA/BGRA swizzle of a 2K mip
+	void BenchSwizzle(const TArray<FString>& Args)
+	{
+		const int32 Iterations = GetIterations(Args);
+		const SIZE_T Size = BenchMipSize * BenchMipSize * 4;
+
+		TArray<uint8> Src;
+		TArray<uint8> DestScalar;
+		TArray<uint8> DestVector;
+		Src.AddUninitialized((int32)Size);
+		DestScalar.AddUninitialized((int32)Size);
+		DestVector.AddUninitialized((int32)Size);
+		FillRandom(Src, 0x5b5);
+
+		double BestScalar = DBL_MAX, TotalScalar = 0.0;
+		double BestVector = DBL_MAX, TotalVector = 0.0;
+
+		// interleaved: both versions see the same cache and clock state
+		for (int32 Iter = 0; Iter < Iterations; ++Iter)
+		{
+			double Start = FPlatformTime::Seconds();
+			Substance::Helpers::CopySwizzleRGBAScalar(DestScalar.GetData(), Src.GetData(), Size);
+			const double Scalar = FPlatformTime::Seconds() - Start;
+
+			Start = FPlatformTime::Seconds();
+			Substance::Helpers::CopySwizzleRGBA(DestVector.GetData(), Src.GetData(), Size);
+			const double Vector = FPlatformTime::Seconds() - Start;
+
+			BestScalar = FMath::Min(BestScalar, Scalar);
+			BestVector = FMath::Min(BestVector, Vector);
+			TotalScalar += Scalar;
+			TotalVector += Vector;
+		}
+
+		const bool bMatch = FMemory::Memcmp(DestScalar.GetData(), DestVector.GetData(), Size) == 0;
+
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("Swizzle RGBA->BGRA, %dx%d mip, %d iterations:"),
+			BenchMipSize, BenchMipSize, Iterations);
+		LogTiming(TEXT("scalar"), BestScalar, TotalScalar, Iterations, Size);
+		LogTiming(TEXT("vectorized"), BestVector, TotalVector, Iterations, Size);
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  speedup x%.2f, results %s"),
+			BestScalar / BestVector,
+			bMatch ? TEXT("identical") : TEXT("DIFFER"));
+	}
+
+	//! @brief Fill a RGBA image w/ smooth gradients and low amplitude noise,
+	//!	closer to the Substance outputs than plain noise
+	void FillGradients(TArray<uint8>& Image, int32 Size, int32 Seed)
+	{
+		FRandomStream Stream(Seed);
+
+		for (int32 Y = 0; Y < Size; ++Y)
+		{
+			for (int32 X = 0; X < Size; ++X)
+			{
+				uint8* Pixel = Image.GetData() + ((SIZE_T)Y * Size + X) * 4;
+				const int32 Noise = Stream.RandHelper(16) - 8;
+
+				Pixel[0] = (uint8)FMath::Clamp(X * 255 / Size + Noise, 0, 255);
+				Pixel[1] = (uint8)FMath::Clamp(Y * 255 / Size + Noise, 0, 255);
+				Pixel[2] = (uint8)FMath::Clamp(((X + Y) / 8 & 0xFF) + Noise, 0, 255);
+				Pixel[3] = (uint8)FMath::Clamp((X ^ Y) & 0xFF, 0, 255);
+			}
+		}
+	}
+
+	//! @brief Decode the color part of a BC1/BC3 block to RGB
+	void DecodeColorBlock(uint8* Block, const uint8* Src)
+	{
+		const uint16 Packed[2] = { (uint16)(Src[0] | (Src[1] << 8)), (uint16)(Src[2] | (Src[3] << 8)) };
+		int32 Palette[4][3];
+
+		for (int32 End = 0; End < 2; ++End)
+		{
+			const int32 R = (Packed[End] >> 11) & 0x1F;
+			const int32 G = (Packed[End] >> 5) & 0x3F;
+			const int32 B = Packed[End] & 0x1F;
+			Palette[End][0] = (R << 3) | (R >> 2);
+			Palette[End][1] = (G << 2) | (G >> 4);
+			Palette[End][2] = (B << 3) | (B >> 2);
+		}
+
+		for (int32 Channel = 0; Channel < 3; ++Channel)
+		{
+			if (Packed[0] > Packed[1])
+			{
+				Palette[2][Channel] = (Palette[0][Channel] * 2 + Palette[1][Channel]) / 3;
+				Palette[3][Channel] = (Palette[0][Channel] + Palette[1][Channel] * 2) / 3;
+			}
+			else
+			{
+				Palette[2][Channel] = (Palette[0][Channel] + Palette[1][Channel]) / 2;
+				Palette[3][Channel] = 0;
+			}
+		}
+
+		const uint32 Indices = Src[4] | (Src[5] << 8) | (Src[6] << 16) | ((uint32)Src[7] << 24);
+		for (int32 Idx = 0; Idx < 16; ++Idx)
+		{
+			const int32* Color = Palette[(Indices >> (Idx * 2)) & 3];
+			Block[Idx * 4 + 0] = (uint8)Color[0];
+			Block[Idx * 4 + 1] = (uint8)Color[1];
+			Block[Idx * 4 + 2] = (uint8)Color[2];
+		}
+	}
+
+	//! @brief Decode a BC4 block (alpha part of BC3) to one channel
+	void DecodeChannelBlock(uint8* Block, const uint8* Src, int32 Channel)
+	{
+		int32 Palette[8] = { Src[0], Src[1] };
+
+		for (int32 Idx = 1; Idx < 7; ++Idx)
+		{
+			Palette[Idx + 1] = Src[0] > Src[1] ?
+				(Src[0] * (7 - Idx) + Src[1] * Idx) / 7 :
+				(Idx < 5 ? (Src[0] * (5 - Idx) + Src[1] * Idx) / 5 : (Idx == 5 ? 0 : 255));
+		}
+
+		uint64 Indices = 0;
+		for (int32 Idx = 0; Idx < 6; ++Idx)
+		{
+			Indices |= (uint64)Src[2 + Idx] << (Idx * 8);
+		}
+
+		for (int32 Idx = 0; Idx < 16; ++Idx)
+		{
+			Block[Idx * 4 + Channel] = (uint8)Palette[(Indices >> (Idx * 3)) & 7];
+		}
+	}
+
+	//! @brief Peak signal to noise ratio of the compressed channels, in dB
+	double ComputePSNR(const uint8* Src, const uint8* Blocks, int32 Size, EPixelFormat Format)
+	{
+		const int32 BlockBytes = GPixelFormats[Format].BlockBytes;
+		const int32 BlocksCount = Size / 4;
+		const int32 NumChannels = Format == PF_BC4 ? 1 : (Format == PF_BC5 ? 2 : (Format == PF_DXT1 ? 3 : 4));
+
+		double SquaredError = 0.0;
+		uint8 Block[64];
+
+		for (int32 BlockY = 0; BlockY < BlocksCount; ++BlockY)
+		{
+			for (int32 BlockX = 0; BlockX < BlocksCount; ++BlockX)
+			{
+				const uint8* Encoded = Blocks + ((SIZE_T)BlockY * BlocksCount + BlockX) * BlockBytes;
+
+				switch (Format)
+				{
+				case PF_DXT1: DecodeColorBlock(Block, Encoded); break;
+				case PF_DXT5: DecodeChannelBlock(Block, Encoded, 3); DecodeColorBlock(Block, Encoded + 8); break;
+				case PF_BC4: DecodeChannelBlock(Block, Encoded, 0); break;
+				case PF_BC5: DecodeChannelBlock(Block, Encoded, 0); DecodeChannelBlock(Block, Encoded + 8, 1); break;
+				default: check(0); break;
+				}
+
+				for (int32 Idx = 0; Idx < 16; ++Idx)
+				{
+					const uint8* Pixel = Src + (((SIZE_T)BlockY * 4 + Idx / 4) * Size + BlockX * 4 + Idx % 4) * 4;
+
+					for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+					{
+						const double Error = (double)Pixel[Channel] - Block[Idx * 4 + Channel];
+						SquaredError += Error * Error;
+					}
+				}
+			}
+		}
+
+		const double MeanError = SquaredError / ((double)Size * Size * NumChannels);
+		return MeanError > 0.0 ? 10.0 * FMath::LogX(10.0f, (float)(255.0 * 255.0 / MeanError)) : 99.0;
+	}
+
+	//! @brief Block compression of a 2K output against the uncompressed upload:
+	//!	encode time, size and quality of each format
+	void BenchBlockCompression(const TArray<FString>& Args)
+	{
+		const int32 Iterations = GetIterations(Args);
+		const SIZE_T RawSize = BenchMipSize * BenchMipSize * 4;
+
+		TArray<uint8> Src;
+		TArray<uint8> Raw;
+		Src.AddUninitialized((int32)RawSize);
+		Raw.AddUninitialized((int32)RawSize);
+		FillGradients(Src, BenchMipSize, 0x5b5);
+
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("Block compression, %dx%d mip, %d iterations:"),
+			BenchMipSize, BenchMipSize, Iterations);
+
+		// uncompressed: one copy of the mip (upload staging)
+		double BestRaw = DBL_MAX, TotalRaw = 0.0;
+		for (int32 Iter = 0; Iter < Iterations; ++Iter)
+		{
+			const double Start = FPlatformTime::Seconds();
+			FMemory::Memcpy(Raw.GetData(), Src.GetData(), RawSize);
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			BestRaw = FMath::Min(BestRaw, Seconds);
+			TotalRaw += Seconds;
+		}
+
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  %-6s %8u KB, best %8.3f ms, avg %8.3f ms"),
+			TEXT("RGBA8"), (uint32)(RawSize / 1024), BestRaw * 1000.0, TotalRaw * 1000.0 / Iterations);
+
+		const EPixelFormat Formats[] = { PF_DXT1, PF_DXT5, PF_BC4, PF_BC5 };
+		const TCHAR* Names[] = { TEXT("BC1"), TEXT("BC3"), TEXT("BC4"), TEXT("BC5") };
+
+		for (int32 FormatIdx = 0; FormatIdx < ARRAY_COUNT(Formats); ++FormatIdx)
+		{
+			const EPixelFormat Format = Formats[FormatIdx];
+			const SIZE_T Size = CalculateImageBytes(BenchMipSize, BenchMipSize, 0, Format);
+
+			TArray<uint8> Blocks;
+			Blocks.AddUninitialized((int32)Size);
+
+			double Best = DBL_MAX, Total = 0.0;
+			for (int32 Iter = 0; Iter < Iterations; ++Iter)
+			{
+				const double Start = FPlatformTime::Seconds();
+				Substance::BlockCompression::Compress(Blocks.GetData(), Src.GetData(), BenchMipSize, BenchMipSize, false, Format);
+				const double Seconds = FPlatformTime::Seconds() - Start;
+
+				Best = FMath::Min(Best, Seconds);
+				Total += Seconds;
+			}
+
+			UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  %-6s %8u KB (x%.0f smaller), best %8.3f ms, avg %8.3f ms, PSNR %5.2f dB"),
+				Names[FormatIdx],
+				(uint32)(Size / 1024),
+				(double)RawSize / Size,
+				Best * 1000.0,
+				Total * 1000.0 / Iterations,
+				ComputePSNR(Src.GetData(), Blocks.GetData(), BenchMipSize, Format));
+		}
+	}
+
+	//! @brief Time the reads of a file, best of the iterations
+	double TimeFileRead(IPlatformFile& PlatformFile, const FString& Path, TArray<uint8>& Buffer, int32 Size, int32 Iterations)
+	{
+		double Best = DBL_MAX;
+
+		for (int32 Iter = 0; Iter < Iterations; ++Iter)
+		{
+			const double Start = FPlatformTime::Seconds();
+			IFileHandle* File = PlatformFile.OpenRead(*Path);
+			const bool bRead = File != NULL && File->Read(Buffer.GetData(), Size);
+			delete File;
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			if (!bRead)
+			{
+				return 0.0;
+			}
+
+			Best = FMath::Min(Best, Seconds);
+		}
+
+		return Best;
+	}
+
+	//! @brief Log the projected read time of an entry on a storage class
+	void LogProjection(const TCHAR* Name, double Bandwidth, int32 RawSize, int32 CompressedSize, double InflateSeconds)
+	{
+		const double RawSeconds = RawSize / Bandwidth;
+		const double CompressedSeconds = CompressedSize / Bandwidth + InflateSeconds;
+
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  %-4s %4.0f MB/s: raw %8.3f ms, compressed %8.3f ms, %s wins"),
+			Name,
+			Bandwidth / (1024.0 * 1024.0),
+			RawSeconds * 1000.0,
+			CompressedSeconds * 1000.0,
+			CompressedSeconds < RawSeconds ? TEXT("compressed") : TEXT("raw"));
+	}
+
+	//! @brief Read of a 2K cache entry payload, deflated as by the cache vs
+	//!	raw: measured on the cache storage, projected on HDD and SSD classes
+	void BenchCacheRead(const TArray<FString>& Args)
+	{
+		const int32 Iterations = GetIterations(Args);
+		const int32 RawSize = BenchMipSize * BenchMipSize * 4;
+
+		TArray<uint8> Src;
+		Src.AddUninitialized(RawSize);
+		FillGradients(Src, BenchMipSize, 0x5b5);
+
+		// same compression as SubstanceCache::WriteEntry
+		TArray<uint8> Compressed;
+		int32 CompressedSize = FCompression::CompressMemoryBound(CacheCompression, RawSize);
+		Compressed.AddUninitialized(CompressedSize);
+
+		double DeflateSeconds = FPlatformTime::Seconds();
+		const bool bCompressed = FCompression::CompressMemory(CacheCompression, Compressed.GetData(), CompressedSize, Src.GetData(), RawSize);
+		DeflateSeconds = FPlatformTime::Seconds() - DeflateSeconds;
+
+		if (!bCompressed)
+		{
+			UE_LOG(LogSubstanceBenchmarks, Warning, TEXT("Cache read benchmark: compression failed"));
+			return;
+		}
+
+		Compressed.RemoveAt(CompressedSize, Compressed.Num() - CompressedSize);
+
+		// written next to the pack: same storage as the cache
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		const FString Directory = FPaths::GameSavedDir() / TEXT("Substance");
+		const FString RawPath = Directory / TEXT("Bench.raw");
+		const FString CompressedPath = Directory / TEXT("Bench.zlib");
+
+		PlatformFile.CreateDirectoryTree(*Directory);
+		if (!FFileHelper::SaveArrayToFile(Src, *RawPath) || !FFileHelper::SaveArrayToFile(Compressed, *CompressedPath))
+		{
+			UE_LOG(LogSubstanceBenchmarks, Warning, TEXT("Cache read benchmark: unable to write to %s"), *Directory);
+			PlatformFile.DeleteFile(*RawPath);
+			PlatformFile.DeleteFile(*CompressedPath);
+			return;
+		}
+
+		TArray<uint8> ReadBuffer;
+		TArray<uint8> Inflated;
+		ReadBuffer.AddUninitialized(RawSize);
+		Inflated.AddUninitialized(RawSize);
+
+		const double RawRead = TimeFileRead(PlatformFile, RawPath, ReadBuffer, RawSize, Iterations);
+		const double CompressedRead = TimeFileRead(PlatformFile, CompressedPath, ReadBuffer, CompressedSize, Iterations);
+
+		double Inflate = DBL_MAX;
+		for (int32 Iter = 0; Iter < Iterations; ++Iter)
+		{
+			const double Start = FPlatformTime::Seconds();
+			FCompression::UncompressMemory(CacheCompression, Inflated.GetData(), RawSize, ReadBuffer.GetData(), CompressedSize);
+			Inflate = FMath::Min(Inflate, FPlatformTime::Seconds() - Start);
+		}
+
+		PlatformFile.DeleteFile(*RawPath);
+		PlatformFile.DeleteFile(*CompressedPath);
+
+		const bool bMatch = FMemory::Memcmp(Inflated.GetData(), Src.GetData(), RawSize) == 0;
+
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("Cache read, %dx%d entry, %d iterations:"),
+			BenchMipSize, BenchMipSize, Iterations);
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  payload raw %u KB, compressed %u KB (%.0f%%), deflate %.3f ms, inflate %.3f ms, %s"),
+			(uint32)(RawSize / 1024),
+			(uint32)(CompressedSize / 1024),
+			100.0 * CompressedSize / RawSize,
+			DeflateSeconds * 1000.0,
+			Inflate * 1000.0,
+			bMatch ? TEXT("identical") : TEXT("DIFFER"));
+
+		// repeated reads are mostly served by the OS file cache: upper bound
+		UE_LOG(LogSubstanceBenchmarks, Display, TEXT("  local (file cache warm): raw %8.3f ms, compressed %8.3f ms (read %.3f + inflate %.3f)"),
+			RawRead * 1000.0,
+			(CompressedRead + Inflate) * 1000.0,
+			CompressedRead * 1000.0,
+			Inflate * 1000.0);
+
+		LogProjection(TEXT("HDD"), HddBandwidth, RawSize, CompressedSize, Inflate);
+		LogProjection(TEXT("SSD"), SsdBandwidth, RawSize, CompressedSize, Inflate);
+	}
+}
+
+static FAutoConsoleCommand GSubstanceBenchSwizzleCommand(
+	TEXT("Substance.Bench.Swizzle"),
+	TEXT("Benchmark the scalar and vectorized RGBA/BGRA swizzle of a 2K mip. Optional: iterations count"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchSwizzle));
+
+static FAutoConsoleCommand GSubstanceBenchBlockCompressionCommand(
+	TEXT("Substance.Bench.BlockCompression"),
+	TEXT("Benchmark the block compression of a 2K output against the uncompressed upload: time, size and PSNR per format. Optional: iterations count"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchBlockCompression));
+
+static FAutoConsoleCommand GSubstanceBenchCacheReadCommand(
+	TEXT("Substance.Bench.CacheRead"),
+	TEXT("Benchmark the read of a 2K cache entry, compressed vs raw, on the cache storage and projected on HDD and SSD bandwidths. Optional: iterations count"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchCacheRead));
+
+#endif // !UE_BUILD_SHIPPING
@@ -0,0 +1,109 @@
+//! @file SubstanceCoreGovernor.cpp
+//! @brief Adaptive CPU cores governor for the Substance engine
+//! @date 20150312
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCoreGovernor.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceSettings.h"
+
+#include "RenderCore.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Governor Cores"), STAT_SubstanceGovernorCores, STATGROUP_Substance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Governor Frame Time (ms)"), STAT_SubstanceGovernorFrameTime, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Governor Raises"), STAT_SubstanceGovernorRaises, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Governor Lowers"), STAT_SubstanceGovernorLowers, STATGROUP_Substance);
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceGovernor, Log, All);
+
+namespace
+{
+	//! @brief Frame times smoothing factor
+	const float SmoothingFactor = 0.1f;
+
+	//! @brief Frame time ratio of target under which cores are raised
+	const float RaiseHeadroom = 0.8f;
+
+	//! @brief Consecutive frames required before a change (hysteresis)
+	const int32 TrendFramesThreshold = 30;
+}
+
+using namespace Substance;
+
+CoreGovernor::CoreGovernor()
+	: SmoothedFrameTimeMs(0.0f)
+	, CoresCount(0)
+	, TrendFrames(0)
+{
+}
+
+int32 CoreGovernor::Update(bool bRenderPending)
+{
+	const USubstanceSettings* Settings = GetDefault<USubstanceSettings>();
+	const int32 MaxCores = FMath::Clamp(Settings->CPUCores, (int32)1, FPlatformMisc::NumberOfCores());
+
+	if (!Settings->bAdaptiveCores)
+	{
+		// Disabled: release the limit once
+		const int32 NewCount = CoresCount != 0 ? MaxCores : 0;
+		CoresCount = 0;
+		TrendFrames = 0;
+		return NewCount;
+	}
+
+	if (CoresCount == 0)
+	{
+		CoresCount = MaxCores;
+	}
+
+	// Frame cost is bounded by the slowest of the game and render threads
+	const float FrameTimeMs = FPlatformTime::ToMilliseconds(FMath::Max(GGameThreadTime, GRenderThreadTime));
+	SmoothedFrameTimeMs = SmoothedFrameTimeMs == 0.0f ?
+		FrameTimeMs :
+		FMath::Lerp(SmoothedFrameTimeMs, FrameTimeMs, SmoothingFactor);
+
+	SET_FLOAT_STAT(STAT_SubstanceGovernorFrameTime, SmoothedFrameTimeMs);
+
+	const float TargetMs = FMath::Max(Settings->FrameTimeTargetMs, 1.0f);
+
+	if (SmoothedFrameTimeMs > TargetMs)
+	{
+		TrendFrames = FMath::Max(TrendFrames, 0) + 1;
+	}
+	else if (SmoothedFrameTimeMs < TargetMs * RaiseHeadroom && bRenderPending)
+	{
+		TrendFrames = FMath::Min(TrendFrames, 0) - 1;
+	}
+	else
+	{
+		TrendFrames = 0;
+	}
+
+	int32 NewCount = FMath::Min(CoresCount, MaxCores);
+
+	if (TrendFrames >= TrendFramesThreshold && NewCount > 1)
+	{
+		--NewCount;
+		INC_DWORD_STAT(STAT_SubstanceGovernorLowers);
+	}
+	else if (TrendFrames <= -TrendFramesThreshold && NewCount < MaxCores)
+	{
+		++NewCount;
+		INC_DWORD_STAT(STAT_SubstanceGovernorRaises);
+	}
+
+	SET_DWORD_STAT(STAT_SubstanceGovernorCores, NewCount);
+
+	if (NewCount == CoresCount)
+	{
+		return 0;
+	}
+
+	UE_LOG(LogSubstanceGovernor, Verbose, TEXT("Frame time %.2fms (target %.2fms), Substance engine cores %d -> %d"),
+		SmoothedFrameTimeMs, TargetMs, CoresCount, NewCount);
+
+	CoresCount = NewCount;
+	TrendFrames = 0;
+
+	return NewCount;
+}
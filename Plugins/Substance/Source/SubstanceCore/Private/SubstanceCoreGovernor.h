@@ -0,0 +1,36 @@
+//! @file SubstanceCoreGovernor.h
+//! @brief Adaptive CPU cores governor for the Substance engine
+//! @date 20150312
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Raises or lowers the CPU cores count used by the Substance
+	//! engine from game thread and render thread frame times headroom
+	class CoreGovernor
+	{
+	public:
+		CoreGovernor();
+
+		//! @brief Sample last frame times, called once per frame
+		//! @param bRenderPending True if renders are pending, cores are only
+		//!		raised when there is something to render
+		//! @return Return the new cores count if it changed, 0 otherwise
+		int32 Update(bool bRenderPending);
+
+		//! @brief Current cores count
+		int32 GetCoresCount() const { return CoresCount; }
+
+	private:
+		//! @brief Smoothed frame time, milliseconds
+		float SmoothedFrameTimeMs;
+
+		//! @brief Current cores count
+		int32 CoresCount;
+
+		//! @brief Consecutive frames over target (positive) or under
+		//! target w/ headroom (negative)
+		int32 TrendFrames;
+	};
+}
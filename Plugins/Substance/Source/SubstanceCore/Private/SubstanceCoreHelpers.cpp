@@ -10,8 +10,17 @@
 #include "SubstanceFGraph.h"
 #include "SubstanceFPackage.h"
 #include "SubstanceCorePreset.h"
+#include "SubstanceBlockCompression.h"
 #include "SubstanceCache.h"
 #include "SubstanceCallbacks.h"
+#include "SubstanceCoreGovernor.h"
+#include "SubstanceCoreScheduler.h"
+#include "SubstanceMipPool.h"
+#include "SubstanceMipStreamer.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceSettings.h"
+#include "SubstanceTexture2DDynamicResource.h"
+#include "SubstanceTextureUpload.h"
 
 #include "framework/renderer.h"
 #include "framework/details/detailslinkdata.h"
@@ -29,6 +38,28 @@
 
 #include "Materials/MaterialExpressionTextureSampleParameter.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SUBSTANCE_SWIZZLE_SSE2 1
+#define SUBSTANCE_SWIZZLE_NEON 0
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SUBSTANCE_SWIZZLE_SSE2 0
+#define SUBSTANCE_SWIZZLE_NEON 1
+#include <arm_neon.h>
+#else
+#define SUBSTANCE_SWIZZLE_SSE2 0
+#define SUBSTANCE_SWIZZLE_NEON 0
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceHelpers, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Publish Outputs"), STAT_SubstancePublishOutputs, STATGROUP_Substance);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Publish Time (ms)"), STAT_SubstancePublishTime, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Published Memory"), STAT_SubstancePublishedBytes, STATGROUP_Substance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Published Outputs"), STAT_SubstancePublishedOutputs, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mips Reused"), STAT_SubstanceMipReused, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mips Reallocated"), STAT_SubstanceMipReallocated, STATGROUP_Substance);
+
 namespace local
 {
 	TArray<USubstanceGraphInstance*> InstancesToDelete;
@@ -49,11 +80,20 @@ Substance::List<graph_inst_t*> LoadingQueue; // queue used by PushDelayedRender
 Substance::List<graph_inst_t*> PriorityLoadingQueue; // queue used by PushDelayedRender & PerformDelayedRender
 
 Substance::List<graph_inst_t*> AsyncQueue; //queue used by RenderAsync
-Substance::List<graph_inst_t*> CurrentRenderQueue;
 Substance::List<graph_inst_t*> BlueprintQueue; //queue used by the blueprint interface
 
 uint32 ASyncRunID = 0;
 
+CoreGovernor GCoreGovernor;
+
+RenderScheduler GRenderScheduler; // runtime instances in flight
+
+MipStreamer GMipStreamer; // runtime instances rendered at a reduced size
+
+TextureUploadBatch GTextureUploads; // textures updated since last submit
+
+bool bRendererUsed = false; // renderer computed something since created
+
 static uint32 GlobalInstancePendingCount = 0;
 static uint32 GlobalInstanceCompletedCount = 0;
 
@@ -84,32 +124,52 @@ void RenderAsync(Substance::List<graph_inst_t*>& Instances)
 }
 
 
-void RenderAsync(graph_inst_t* Instance)
+//! @brief Read the instance from the disk cache or queue it for render
+static void QueueRender(graph_inst_t* Instance, Substance::List<graph_inst_t*>& Queue)
 {
-	//If this graph has been cached before, read from disk
+	//a read still pending is of a previous state, it would be published
+	//over the new one. It was already counted as pending.
+	const bool bWasReading = Substance::SubstanceCache::Get()->CancelReads(Instance);
+
+	//If this graph has been cached before, read from disk in the background
 	if (Instance->ParentInstance->bCooked && Instance->ParentInstance->Parent->ShouldCacheOutput())
 	{
-		if (Substance::SubstanceCache::Get()->ReadFromCache(Instance))
+		if (Substance::SubstanceCache::Get()->ReadFromCacheAsync(Instance))
 		{
-			Instance->ParentInstance->Parent->SubstancePackage->LinkData.reset();
-			++GlobalInstanceCompletedCount;
-			++GlobalInstancePendingCount;
+			// completed once published, see PublishCachedOutputs
+			if (!bWasReading)
+			{
+				++GlobalInstancePendingCount;
+			}
 			return;
 		}
 	}
 
 	//no cache available, queue for pending
-	uint32 OldSize = AsyncQueue.size();
+	uint32 OldSize = Queue.size();
 
-	AsyncQueue.AddUnique(Instance);
+	Queue.AddUnique(Instance);
 
-	if (AsyncQueue.size() > OldSize)
+	if (Queue.size() > OldSize && !bWasReading)
 	{
 		++GlobalInstancePendingCount;
 	}
 }
 
 
+void RenderAsync(graph_inst_t* Instance)
+{
+	QueueRender(Instance, AsyncQueue);
+}
+
+
+void RenderVisible(graph_inst_t* Instance)
+{
+	// admitted with the blueprint changes, ahead of loading work
+	QueueRender(Instance, BlueprintQueue);
+}
+
+
 void RenderSync(Substance::List<graph_inst_t*>& Instances)
 {
 	GSubstanceRenderer->setRenderCallbacks(NULL);
@@ -152,6 +212,12 @@ void PushDelayedRender(graph_inst_t* Instance)
 	{
 		if (false == Instance->bHasPendingImageInputRendering)
 		{
+			// start reading the cache entries while the level loads
+			if (Instance->ParentInstance->bCooked && Instance->ParentInstance->Parent->ShouldCacheOutput())
+			{
+				Substance::SubstanceCache::Get()->Prefetch(Instance);
+			}
+
 			switch (Instance->ParentInstance->Parent->GetGenerationMode())
             {
             case SGM_OnLoadAsync:
@@ -252,13 +318,151 @@ void PerformDelayedRender()
 		RenderAsync(LoadingQueue);
 		LoadingQueue.Empty();
 	}
+
+	// prefetched entries not read by now were keyed on a different state
+	Substance::SubstanceCache::Get()->DropPrefetches();
 }
 
 
-void UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText)
+void CopySwizzleRGBA(void* Dest, const void* Src, SIZE_T Size)
 {
-	// make sure any outstanding resource update has been completed
-	FlushRenderingCommands();
+	check(Size % 4 == 0);
+
+	const uint8* SrcPtr = (const uint8*)Src;
+	uint8* DestPtr = (uint8*)Dest;
+	SIZE_T Idx = 0;
+
+#if SUBSTANCE_SWIZZLE_SSE2
+	// 4 pixels per iteration: r and b swapped w/ shifts, g and a masked
+	const __m128i MaskGA = _mm_set1_epi32(0xFF00FF00);
+	const __m128i MaskR = _mm_set1_epi32(0x000000FF);
+
+	for (; Idx + 16 <= Size; Idx += 16)
+	{
+		const __m128i Pixels = _mm_loadu_si128((const __m128i*)(SrcPtr + Idx));
+		const __m128i R = _mm_and_si128(Pixels, MaskR);
+		const __m128i B = _mm_and_si128(_mm_srli_epi32(Pixels, 16), MaskR);
+		const __m128i Result = _mm_or_si128(
+			_mm_and_si128(Pixels, MaskGA),
+			_mm_or_si128(_mm_slli_epi32(R, 16), B));
+		_mm_storeu_si128((__m128i*)(DestPtr + Idx), Result);
+	}
+#elif SUBSTANCE_SWIZZLE_NEON
+	// 16 pixels per iteration: deinterleaved load, r and b lanes swapped
+	for (; Idx + 64 <= Size; Idx += 64)
+	{
+		uint8x16x4_t Pixels = vld4q_u8(SrcPtr + Idx);
+		const uint8x16_t R = Pixels.val[0];
+		Pixels.val[0] = Pixels.val[2];
+		Pixels.val[2] = R;
+		vst4q_u8(DestPtr + Idx, Pixels);
+	}
+#endif
+
+	// remaining pixels
+	CopySwizzleRGBAScalar(DestPtr + Idx, SrcPtr + Idx, Size - Idx);
+}
+
+
+void CopySwizzleRGBAScalar(void* Dest, const void* Src, SIZE_T Size)
+{
+	check(Size % 4 == 0);
+
+	const uint8* SrcPtr = (const uint8*)Src;
+	uint8* DestPtr = (uint8*)Dest;
+
+	// read before written: Dest can be Src
+	for (SIZE_T Idx = 0; Idx < Size; Idx += 4)
+	{
+		const uint8 R = SrcPtr[Idx + 0];
+		const uint8 B = SrcPtr[Idx + 2];
+		DestPtr[Idx + 0] = B;
+		DestPtr[Idx + 1] = SrcPtr[Idx + 1];
+		DestPtr[Idx + 2] = R;
+		DestPtr[Idx + 3] = SrcPtr[Idx + 3];
+	}
+}
+
+
+void* LockMipForWrite(FTexture2DMipMap* MipMap, SIZE_T ImageSize, bool* bOutReused /*= NULL*/)
+{
+	// reuse the loaded storage of the previous render
+	const bool bReuse = MipMap->BulkData.IsBulkDataLoaded() &&
+		(SIZE_T)MipMap->BulkData.GetBulkDataSize() == ImageSize;
+
+	if (bOutReused)
+	{
+		*bOutReused = bReuse;
+	}
+
+	if (bReuse)
+	{
+		INC_DWORD_STAT(STAT_SubstanceMipReused);
+		return MipMap->BulkData.Lock(LOCK_READ_WRITE);
+	}
+
+	INC_DWORD_STAT(STAT_SubstanceMipReallocated);
+
+	MipMap->BulkData = FByteBulkData();
+	MipMap->BulkData.Lock(LOCK_READ_WRITE);
+	return MipMap->BulkData.Realloc(ImageSize);
+}
+
+
+bool WriteMipData(void* Dest, const void* Src, SIZE_T Size, bool bSwizzle, bool bCompare)
+{
+	if (!bCompare)
+	{
+		if (bSwizzle)
+		{
+			CopySwizzleRGBA(Dest, Src, Size);
+		}
+		else
+		{
+			FMemory::Memcpy(Dest, Src, Size);
+		}
+
+		return true;
+	}
+
+	// compared and written by chunks: Dest is read and written once
+	uint8 Chunk[4096];
+	uint8* DestPtr = (uint8*)Dest;
+	const uint8* SrcPtr = (const uint8*)Src;
+	bool bChanged = false;
+
+	for (SIZE_T Offset = 0; Offset < Size; Offset += sizeof(Chunk))
+	{
+		const SIZE_T ChunkSize = FMath::Min(Size - Offset, sizeof(Chunk));
+		const uint8* ChunkPtr = SrcPtr + Offset;
+
+		if (bSwizzle)
+		{
+			CopySwizzleRGBA(Chunk, ChunkPtr, ChunkSize);
+			ChunkPtr = Chunk;
+		}
+
+		if (FMemory::Memcmp(DestPtr + Offset, ChunkPtr, ChunkSize) != 0)
+		{
+			FMemory::Memcpy(DestPtr + Offset, ChunkPtr, ChunkSize);
+			bChanged = true;
+		}
+	}
+
+	return bChanged;
+}
+
+
+bool UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, bool bCopyMips /*= true*/, EPixelFormat CompressedFormat /*= PF_Unknown*/, uint32* OutChangedMips /*= NULL*/)
+{
+	// compressed mips are always copies of the result
+	const bool bCompress = CompressedFormat != PF_Unknown;
+	check(bCopyMips || !bCompress);
+
+	// no flush: uploads are made from copies of the mips (TextureUploadBatch)
+	const EPixelFormat PreviousFormat = Texture->Format;
+	bool bResourceChanged = false;
+	uint32 ChangedMips = 0;
 
 	// grab the Result computed in the Substance Thread
 	const SIZE_T Mipstart = (SIZE_T) ResultText.buffer;
@@ -267,16 +471,24 @@ void UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture&
 	// prepare mip map data
 	FTexture2DMipMap* MipMap = 0;
 
-	Texture->Format = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+	const EPixelFormat ResultFormat = Substance::Helpers::SubstanceToUe3Format((SubstancePixelFormat)ResultText.pixelFormat);
+
+	Texture->Format = bCompress ? CompressedFormat : ResultFormat;
 
 	Texture->NumMips = ResultText.mipmapCount;
 
+	// results already in bgra order (cached or engine side) are copied as is
+	const bool bSrcBGRA = ResultText.channelsOrder == Substance_ChanOrder_BGRA;
+	const bool bSwizzle = ResultFormat == PF_B8G8R8A8 && !bSrcBGRA;
+
 	// create as much mip as necessary
 	if (Texture->Mips.Num() != ResultText.mipmapCount ||
 		ResultText.level0Width != Texture->SizeX ||
 		ResultText.level0Height != Texture->SizeY)
 	{
+		bResourceChanged = true;
 		Texture->Mips.Empty();
+		Texture->bUsePlaceholder = false;
 
 		int32 MipSizeX = Texture->SizeX = ResultText.level0Width;
 		int32 MipSizeY = Texture->SizeY = ResultText.level0Height;
@@ -310,38 +522,84 @@ void UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture&
 			Texture->Format);
 		check(0 != ImageSize);
 
-		// copy the data
-		MipMap->BulkData = FByteBulkData();
-		MipMap->BulkData.Lock(LOCK_READ_WRITE);
-		void* TheMipDataPtr = MipMap->BulkData.Realloc(ImageSize);
+		if (bCompress)
+		{
+			// the result mips are not padded to the block size
+			const int32 SrcSizeX = FMath::Max(ResultText.level0Width >> IdxMip, 1);
+			const int32 SrcSizeY = FMath::Max(ResultText.level0Height >> IdxMip, 1);
 
-		FMemory::Memcpy(TheMipDataPtr, (void*)(Mipstart + MipOffset), ImageSize);
+			bool bReused = false;
+			void* TheMipDataPtr = LockMipForWrite(MipMap, ImageSize, &bReused);
 
-		if (Texture->Format == PF_B8G8R8A8)
-		{
-			uint8 temp;
-			uint8* Pixels = (uint8*)TheMipDataPtr;
+			// compressed aside when the previous content can be compared
+			uint8* Blocks = bReused ? MipBufferPool::Get().Alloc(ImageSize) : (uint8*)TheMipDataPtr;
+
+			BlockCompression::Compress(
+				Blocks,
+				(const uint8*)(Mipstart + MipOffset),
+				SrcSizeX,
+				SrcSizeY,
+				bSrcBGRA,
+				Texture->Format);
 
-			for (SIZE_T Idx = 0; Idx < ImageSize; Idx +=4)
+			if (!bReused || WriteMipData(TheMipDataPtr, Blocks, ImageSize, false, true))
 			{
-				// substance outputs rgba8, convert to bgra8
-				// r, g, b, a = b, g, r, a
-				temp = Pixels[0];
-				Pixels[0] = Pixels[2];
-				Pixels[2] = temp;
+				ChangedMips |= 1u << IdxMip;
+			}
 
-				Pixels += 4;
+			if (bReused)
+			{
+				MipBufferPool::Get().Free(Blocks, ImageSize);
 			}
+
+			MipOffset += SrcSizeX * SrcSizeY * 4;
+			MipMap->BulkData.ClearBulkDataFlags( BULKDATA_SingleUse );
+			MipMap->BulkData.Unlock();
+			continue;
+		}
+
+		if (!bCopyMips)
+		{
+			// the result buffer is uploaded as is: swizzle in place and
+			// drop the previous content of the mip
+			if (bSwizzle)
+			{
+				void* ResultMipPtr = (void*)(Mipstart + MipOffset);
+				CopySwizzleRGBA(ResultMipPtr, ResultMipPtr, ImageSize);
+			}
+
+			MipOffset += ImageSize;
+			MipMap->BulkData.RemoveBulkData();
+			ChangedMips |= 1u << IdxMip;
+			continue;
+		}
+
+		// copy the data, in place if the mip storage has the right size:
+		// the previous content tells if the mip has to be uploaded again
+		bool bReused = false;
+		void* TheMipDataPtr = LockMipForWrite(MipMap, ImageSize, &bReused);
+
+		// substance outputs rgba8, converted to bgra8 while copying
+		if (WriteMipData(TheMipDataPtr, (void*)(Mipstart + MipOffset), ImageSize, bSwizzle, bReused))
+		{
+			ChangedMips |= 1u << IdxMip;
 		}
 	
 		MipOffset += ImageSize;
 		MipMap->BulkData.ClearBulkDataFlags( BULKDATA_SingleUse );
 		MipMap->BulkData.Unlock();
 	}
+
+	if (OutChangedMips)
+	{
+		*OutChangedMips = ChangedMips;
+	}
+
+	return bResourceChanged || PreviousFormat != Texture->Format;
 }
 
 
-void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults /*= true*/)
+void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults /*= true*/, output_inst_t::Result* AdoptedResult /*= NULL*/)
 {
 	USubstanceTexture2D* Texture = *(Output->Texture.get());
 
@@ -367,8 +625,31 @@ void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool b
 		}
 	}
 
-	Helpers::UpdateSubstanceOutput(Texture, result);
-	Texture->UpdateResource();
+	// raw outputs compressed before upload, from the result to the mips
+	const EPixelFormat CompressedFormat = BlockCompression::GetFormat(Output, result);
+
+	// the editor saves the textures mips, they must be kept in bulk data
+	const bool bAdopt = AdoptedResult != NULL && AdoptedResult->get() != NULL && !GIsEditor &&
+		PF_Unknown == CompressedFormat;
+
+	// same size and format: keep the resource, only upload the changed mips
+	uint32 ChangedMips = 0;
+
+	if (Helpers::UpdateSubstanceOutput(Texture, result, !bAdopt, CompressedFormat, &ChangedMips) || NULL == Texture->Resource)
+	{
+		Texture->RecreateResource();
+		ChangedMips = ~0u;
+	}
+
+	if (bAdopt)
+	{
+		// uploaded from the engine buffer, released after upload
+		GTextureUploads.Adopt(Texture, AdoptedResult->release());
+	}
+	else
+	{
+		GTextureUploads.Add(Texture, ChangedMips);
+	}
 
 	Texture->OutputCopy->bIsDirty = false;
 
@@ -435,32 +716,111 @@ void StartPIE()
 			bUpdatedOutput = true;
 		}
 	}
+
+	GTextureUploads.Submit();
 #endif
 }
 
 
-void Tick()
+SIZE_T GetResultSize(const SubstanceTexture& Result)
 {
-	//update outputs
-	Substance::List<output_inst_t*> Outputs =
-		RenderCallbacks::getComputedOutputs(!GIsEditor);
-		
-	Substance::List<output_inst_t*>::TIterator ItOut(Outputs.itfront());
+	EPixelFormat Format = SubstanceToUe3Format((SubstancePixelFormat)Result.pixelFormat);
 
-	bool bUpdatedOutput = false;
+	if (Format == PF_Unknown)
+	{
+		Format = PF_B8G8R8A8;
+	}
 
-	for (; ItOut; ++ItOut)
+	return CalcTextureSize(Result.level0Width, Result.level0Height, Format, Result.mipmapCount);
+}
+
+
+bool PublishComputedOutputs()
+{
+	SCOPE_CYCLE_COUNTER(STAT_SubstancePublishOutputs);
+
+	const USubstanceSettings* Settings = GetDefault<USubstanceSettings>();
+	const double BudgetSeconds = Settings->OutputUploadBudgetMs / 1000.0f;
+	const SIZE_T BudgetBytes = (SIZE_T)Settings->OutputUploadBudgetKb * 1024;
+
+	const double StartTime = FPlatformTime::Seconds();
+	double ElapsedSeconds = 0.0;
+	SIZE_T PublishedBytes = 0;
+	int32 PublishedCount = 0;
+
+	// publish at least one output per tick, then until a budget is spent
+	Substance::List<output_inst_t*> Outputs;
+
+	while ((PublishedCount == 0 || 
+			((BudgetSeconds <= 0.0 || ElapsedSeconds < BudgetSeconds) &&
+			 (BudgetBytes == 0 || PublishedBytes < BudgetBytes))) &&
+		RenderCallbacks::drainComputedOutputs(Outputs, 1))
 	{
+		output_inst_t* Output = Outputs.pop();
+
 		// Grab Result (auto pointer on RenderResult)
-		output_inst_t::Result Result = ((*ItOut)->grabResult());
+		output_inst_t::Result Result = Output->grabResult();
 
 		if (Result.get())
 		{
-			UpdateTexture(Result->getTexture(), *ItOut);
-			bUpdatedOutput = true;
+			PublishedBytes += GetResultSize(Result->getTexture());
+			UpdateTexture(Result->getTexture(), Output, true, &Result);
+			++PublishedCount;
 		}
+
+		ElapsedSeconds = FPlatformTime::Seconds() - StartTime;
 	}
 
+	// one render command for all the outputs of the frame
+	GTextureUploads.Submit();
+
+	SET_FLOAT_STAT(STAT_SubstancePublishTime, (float)(ElapsedSeconds * 1000.0));
+	SET_MEMORY_STAT(STAT_SubstancePublishedBytes, PublishedBytes);
+	SET_DWORD_STAT(STAT_SubstancePublishedOutputs, PublishedCount);
+
+	return PublishedCount != 0;
+}
+
+
+bool PublishCachedOutputs()
+{
+	Substance::List<graph_inst_t*> CompletedGraphs;
+	Substance::List<graph_inst_t*> FailedGraphs;
+
+	Substance::SubstanceCache::Get()->PublishReads(CompletedGraphs, FailedGraphs);
+
+	for (auto itG = CompletedGraphs.itfront(); itG; ++itG)
+	{
+		(*itG)->ParentInstance->Parent->SubstancePackage->ConditionnalClearLinkData();
+	}
+
+	GlobalInstanceCompletedCount += CompletedGraphs.Num();
+
+	// already counted as pending
+	for (auto itG = FailedGraphs.itfront(); itG; ++itG)
+	{
+		AsyncQueue.AddUnique(*itG);
+	}
+
+	return CompletedGraphs.Num() != 0;
+}
+
+
+void Tick()
+{
+	// fire continuations of completed runs, on the game thread
+	GSubstanceRenderer->dispatchCompletions();
+
+	// adapt engine cores to frame time headroom
+	if (GCoreGovernor.Update(ASyncRunID != 0 || !GRenderScheduler.IsIdle() || AsyncQueue.Num() != 0 || BlueprintQueue.Num() != 0))
+	{
+		GSubstanceRenderer->setCoresLimit(GCoreGovernor.GetCoresCount());
+	}
+
+	//update outputs
+	bool bUpdatedOutput = PublishComputedOutputs();
+	bUpdatedOutput = PublishCachedOutputs() || bUpdatedOutput;
+
 #if WITH_EDITOR
 	if (bUpdatedOutput)
 	{
@@ -470,57 +830,98 @@ void Tick()
 	}
 #endif
 
-	//check if our last async job has completed
-	if (!GIsEditor && CurrentRenderQueue.Num() && ASyncRunID != 0 && !GSubstanceRenderer->isPending(ASyncRunID) && RenderCallbacks::isOutputQueueEmpty())
+#if WITH_EDITOR
+	//push async substances to renderer
+	if (AsyncQueue.Num() && 0 == ASyncRunID)
 	{
-		ASyncRunID = 0;
+		GSubstanceRenderer->push(AsyncQueue);
+		AsyncQueue.Empty();
 
-		// free some memory by reseting the engine each batch of rendering
-		GSubstanceRenderer = TSharedPtr<Substance::Renderer>(new Substance::Renderer());
-		GSubstanceRenderer->setRenderCallbacks(gCallbacks.Get());
+		// edited instances, interactive priority
+		ASyncRunID = GSubstanceRenderer->run(
+			Substance::Renderer::Run_Asynchronous |
+			Substance::Renderer::Run_Replace,
+			Substance::Renderer::Priority_Interactive);
+	}
+#else // WITH_EDITOR
+	// retire instances whose outputs are all computed and uploaded
+	Substance::List<graph_inst_t*> CompletedQueue;
 
-		for (auto itG = CurrentRenderQueue.itfront(); itG; ++itG)
+	if (GRenderScheduler.Retire(CompletedQueue))
+	{
+		for (auto itG = CompletedQueue.itfront(); itG; ++itG)
 		{
 			(*itG)->ParentInstance->Parent->SubstancePackage->ConditionnalClearLinkData();
 		}
 
-		GlobalInstanceCompletedCount += CurrentRenderQueue.Num();
-		CurrentRenderQueue.Empty();	
+		GlobalInstanceCompletedCount += CompletedQueue.Num();
+		GMipStreamer.Rendered(CompletedQueue);
 	}
-	
-#if WITH_EDITOR
-	//push async substances to renderer
-	if (AsyncQueue.Num() && 0 == ASyncRunID)
+
+	// render higher mips of the reduced instances being drawn
+	GMipStreamer.Update();
+
+	if (GRenderScheduler.IsIdle() && bRendererUsed && 
+		AsyncQueue.Num() == 0 && BlueprintQueue.Num() == 0)
 	{
-		GSubstanceRenderer->push(AsyncQueue);
-		AsyncQueue.Empty();
-#else // WITH_EDITOR
-	if ((AsyncQueue.Num() || BlueprintQueue.Num()) && !CurrentRenderQueue.Num()/*&& ASyncRunID == 0*/)
+		ASyncRunID = 0;
+		bRendererUsed = false;
+
+		// free some memory when the pipeline drains, engine stays linked,
+		// trimmed by the render threads
+		GSubstanceRenderer->trim();
+		const SIZE_T FreedBytes = MipBufferPool::Get().Trim();
+		UE_LOG(LogSubstanceHelpers, Verbose, TEXT("Substance mip buffers trimmed, %u KB freed"), (uint32)(FreedBytes / 1024));
+	}
+
+	// reduce the size of new instances before estimating their footprint
+	GMipStreamer.Clamp(BlueprintQueue);
+	GMipStreamer.Clamp(AsyncQueue);
+
+	// admit queued instances while their outputs fit in the memory budget,
+	// instances changed by gameplay are visible ones, render them first
+	Substance::List<graph_inst_t*> VisibleQueue;
+
+	if (GRenderScheduler.Admit(BlueprintQueue, VisibleQueue))
 	{
-		// limit the number of substances being rendered at the same time
-		// to save some memory
-		const int BatchSize = 4;
+		GSubstanceRenderer->push(VisibleQueue);
+		const RenderFuture::SPtr VisibleRun = GSubstanceRenderer->runAsync(
+			Substance::Renderer::Run_Asynchronous |
+			Substance::Renderer::Run_Replace,
+			Substance::Renderer::Priority_Visible);
 
-		while (AsyncQueue.Num() != 0 && CurrentRenderQueue.Num() <= BatchSize)
-		{
-			CurrentRenderQueue.AddUnique(AsyncQueue.pop());
-		}
+		GRenderScheduler.Launch(VisibleRun);
+		bRendererUsed = true;
 
-		while (BlueprintQueue.Num() != 0 && CurrentRenderQueue.Num() <= BatchSize)
+		if (VisibleRun->getRunUid() != 0)
 		{
-			CurrentRenderQueue.AddUnique(BlueprintQueue.pop());
+			ASyncRunID = VisibleRun->getRunUid();
 		}
+	}
 
-		GSubstanceRenderer->push(CurrentRenderQueue);
-#endif //WITH_EDITOR
+	// loading instances, processed in background
+	Substance::List<graph_inst_t*> BackgroundQueue;
 
-		ASyncRunID = GSubstanceRenderer->run(
+	if (GRenderScheduler.Admit(AsyncQueue, BackgroundQueue))
+	{
+		GSubstanceRenderer->push(BackgroundQueue);
+		const RenderFuture::SPtr BackgroundRun = GSubstanceRenderer->runAsync(
 			Substance::Renderer::Run_Asynchronous |
-			Substance::Renderer::Run_Replace |	
-			Substance::Renderer::Run_First |
-			Substance::Renderer::Run_PreserveRun
-			);
+			Substance::Renderer::Run_Replace,
+			Substance::Renderer::Priority_Background);
+
+		GRenderScheduler.Launch(BackgroundRun);
+		bRendererUsed = true;
+
+		if (BackgroundRun->getRunUid() != 0)
+		{
+			ASyncRunID = BackgroundRun->getRunUid();
+		}
 	}
+#endif //WITH_EDITOR
+
+	// textures updated out of the publish loop (cache reads)
+	GTextureUploads.Submit();
 
 	Substance::Helpers::PerformDelayedDeletion();
 }
@@ -642,6 +1043,8 @@ bool UpdateTextures(Substance::List<FGraphInstance*>& Instances)
 		}
 	}
 
+	GTextureUploads.Submit();
+
 	return GotSomething;
 }
 
@@ -733,8 +1136,8 @@ void CreatePlaceHolderMips(graph_inst_t* Instance)
 	// Iterate on all Outputs
 	Substance::List<output_inst_t>::TIterator ItOut(Instance->Outputs.itfront());
 
-	// for each enabled output, create a placeholder mipmap pyramid 
-	// with the following format & size : PF_B8G8R8A8 16x16
+	// each enabled output w/o content shows the shared placeholder texture
+	// (PF_B8G8R8A8 16x16) until its first render, no mips are allocated
 	for (; ItOut; ++ItOut)
 	{
 		if (false == ItOut->bIsEnabled)
@@ -743,68 +1146,22 @@ void CreatePlaceHolderMips(graph_inst_t* Instance)
 		}
 
 		USubstanceTexture2D* Texture = *ItOut->Texture;
-		FTexture2DMipMap* MipMap = 0;
-
-		Texture->Format = PF_B8G8R8A8;
-
-		Texture->NumMips = 4;	
-		Texture->Mips.Empty();
-
-		int32 MipSizeX = Texture->SizeX = 16;
-		int32 MipSizeY = Texture->SizeY = 16;
-		SIZE_T MipOffset = 0;
 
-		for (int32 IdxMip = 0; IdxMip < Texture->NumMips; ++IdxMip)
+		// already showing the placeholder
+		if (Texture->bUsePlaceholder && 0 == Texture->Mips.Num() && Texture->Resource)
 		{
-			MipMap = new(Texture->Mips) FTexture2DMipMap;
-			MipMap->SizeX = MipSizeX;
-			MipMap->SizeY = MipSizeY;
-
-			// compute the next mip size
-			MipSizeX = FMath::Max(MipSizeX >> 1, 1);
-			MipSizeY = FMath::Max(MipSizeY >> 1, 1);
-
-			// not smaller than the "block size"
-			MipSizeX = FMath::Max((int32)GPixelFormats[Texture->Format].BlockSizeX, MipSizeX);
-			MipSizeY = FMath::Max((int32)GPixelFormats[Texture->Format].BlockSizeY, MipSizeY);
+			continue;
 		}
-	
 
-		// fill up the mips
-		for (int32 IdxMip = 0; IdxMip < Texture->NumMips; ++IdxMip)
-		{
-			MipMap = &Texture->Mips[IdxMip];
-
-			// get the size of the mip's content
-			const SIZE_T ImageSize = CalculateImageBytes(
-				MipMap->SizeX,
-				MipMap->SizeY,
-				0,
-				Texture->Format);
-			check(0 != ImageSize);
-
-			// copy the data
-			MipMap->BulkData = FByteBulkData();
-			MipMap->BulkData.Lock(LOCK_READ_WRITE);
-			void* TheMipDataPtr = MipMap->BulkData.Realloc(ImageSize);
-
-			uint8* Pixels = (uint8*)TheMipDataPtr;
-
-			for (SIZE_T Idx = 0; Idx < ImageSize; Idx += 4)
-			{
-				Pixels[0] = 128;
-				Pixels[1] = 128;
-				Pixels[2] = 128;
-				Pixels[3] = 0;
-				Pixels += 4;
-			}
-			
-			MipOffset += ImageSize;
-			MipMap->BulkData.ClearBulkDataFlags(BULKDATA_SingleUse);
-			MipMap->BulkData.Unlock();
-		}
+		Texture->Format = PF_B8G8R8A8;
+		Texture->NumMips = 0;
+		Texture->Mips.Empty();
+		Texture->SizeX = FSubstancePlaceholderTexture::Size;
+		Texture->SizeY = FSubstancePlaceholderTexture::Size;
+		Texture->bUsePlaceholder = true;
 
-		Texture->UpdateResource();
+		// nothing to upload
+		Texture->RecreateResource();
 	}
 }
 
@@ -1100,6 +1457,9 @@ void SetupSubstance()
 
 void TearDownSubstance()
 {
+	GTextureUploads.Flush();
+	MipBufferPool::Get().Trim();
+
 	GSubstanceRenderer.Reset();
 	SubstanceCache::Shutdown();
 }
@@ -1780,6 +2140,9 @@ void ClearFromRender(USubstanceGraphInstance* GraphInstance)
 	LoadingQueue.Remove(GraphInstance->Instance);
 	PriorityLoadingQueue.Remove(GraphInstance->Instance);
 	BlueprintQueue.Remove(GraphInstance->Instance);
+	GRenderScheduler.Remove(GraphInstance->Instance);
+	GMipStreamer.Remove(GraphInstance->Instance);
+	Substance::SubstanceCache::Get()->CancelReads(GraphInstance->Instance);
 
 	Substance::List<output_inst_t>::TIterator
 		ItOut(GraphInstance->Instance->Outputs.itfront());
@@ -0,0 +1,195 @@
+//! @file SubstanceCoreScheduler.cpp
+//! @brief Memory budget aware scheduling of runtime Substance renders
+//! @date 20150319
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCoreScheduler.h"
+#include "SubstanceCoreHelpers.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceFGraph.h"
+#include "SubstanceFOutput.h"
+#include "SubstanceInput.h"
+#include "SubstanceSettings.h"
+
+#include "RenderCore.h"
+
+DECLARE_MEMORY_STAT(TEXT("Scheduler In Flight Memory"), STAT_SubstanceSchedulerFootprint, STATGROUP_Substance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler In Flight Instances"), STAT_SubstanceSchedulerInFlight, STATGROUP_Substance);
+
+namespace
+{
+	//! @brief Output size used if the graph has no $outputsize input (log2)
+	const int32 DefaultSizeLog2 = 8;
+
+	//! @brief Maximum output size (log2)
+	const int32 MaxSizeLog2 = 13;
+}
+
+using namespace Substance;
+
+RenderScheduler::RenderScheduler()
+	: InFlightFootprint(0)
+	, FirstUnlaunched(0)
+{
+}
+
+SIZE_T RenderScheduler::EstimateFootprint(graph_inst_t* Instance)
+{
+	// Output size, log2
+	int32 SizeLog2X = DefaultSizeLog2;
+	int32 SizeLog2Y = DefaultSizeLog2;
+
+	for (auto ItIn = Instance->Inputs.itfront(); ItIn; ++ItIn)
+	{
+		input_inst_t* Input = ItIn->Get();
+
+		if (Input && 
+			Input->Desc->Type == Substance_IType_Integer2 &&
+			Input->Desc->Identifier == TEXT("$outputsize"))
+		{
+			const vec2int_t& Value = ((FNumericalInputInstance<vec2int_t>*)Input)->Value;
+			SizeLog2X = Value.X;
+			SizeLog2Y = Value.Y;
+			break;
+		}
+	}
+
+	SizeLog2X = FMath::Clamp(SizeLog2X, 0, MaxSizeLog2);
+	SizeLog2Y = FMath::Clamp(SizeLog2Y, 0, MaxSizeLog2);
+	const int32 MipCount = FMath::Max(SizeLog2X, SizeLog2Y) + 1;
+
+	SIZE_T Footprint = 0;
+
+	for (auto ItOut = Instance->Outputs.itfront(); ItOut; ++ItOut)
+	{
+		if (!(*ItOut).bIsEnabled)
+		{
+			continue;
+		}
+
+		EPixelFormat Format = Helpers::SubstanceToUe3Format((SubstancePixelFormat)(*ItOut).Format);
+
+		if (Format == PF_Unknown)
+		{
+			// unsupported formats are converted to RGBA
+			Format = PF_B8G8R8A8;
+		}
+
+		Footprint += CalcTextureSize(1 << SizeLog2X, 1 << SizeLog2Y, Format, MipCount);
+	}
+
+	return Footprint;
+}
+
+int32 RenderScheduler::Admit(
+	Substance::List<graph_inst_t*>& Queue,
+	Substance::List<graph_inst_t*>& Admitted)
+{
+	const int32 BudgetMb = FMath::Clamp(GetDefault<USubstanceSettings>()->MemoryBudgetMb, SBS_MIN_MEM_BUDGET, SBS_MAX_MEM_BUDGET);
+	const SIZE_T Budget = (SIZE_T)BudgetMb * 1024 * 1024;
+
+	int32 AdmittedCount = 0;
+
+	while (Queue.Num() != 0)
+	{
+		graph_inst_t* Instance = Queue.Last();
+		const SIZE_T Footprint = EstimateFootprint(Instance);
+
+		// always admit one instance when idle, even over budget
+		if (InFlight.Num() != 0 && InFlightFootprint + Footprint > Budget)
+		{
+			break;
+		}
+
+		Queue.pop();
+
+		int32 AdmittedIdx;
+		if (Admitted.FindItem(Instance, AdmittedIdx))
+		{
+			continue;
+		}
+
+		// an instance queued again while in flight is tracked twice, its
+		// footprint is conservatively accounted for each run
+		Admitted.push(Instance);
+
+		FInFlight Entry;
+		Entry.Instance = Instance;
+		Entry.Footprint = Footprint;
+		InFlight.Add(Entry);
+
+		InFlightFootprint += Footprint;
+		++AdmittedCount;
+	}
+
+	SET_MEMORY_STAT(STAT_SubstanceSchedulerFootprint, InFlightFootprint);
+	SET_DWORD_STAT(STAT_SubstanceSchedulerInFlight, InFlight.Num());
+
+	return AdmittedCount;
+}
+
+void RenderScheduler::Launch(const RenderFuture::SPtr& Future)
+{
+	for (int32 Idx = FirstUnlaunched; Idx < InFlight.Num(); ++Idx)
+	{
+		InFlight[Idx].Future = Future;
+	}
+
+	FirstUnlaunched = InFlight.Num();
+}
+
+int32 RenderScheduler::Retire(Substance::List<graph_inst_t*>& Completed)
+{
+	int32 RetiredCount = 0;
+
+	for (int32 Idx = 0; Idx < FirstUnlaunched; )
+	{
+		const FInFlight& Entry = InFlight[Idx];
+		bool bDone = Entry.Future->isDone();
+
+		// computed outputs not yet grabbed and uploaded
+		for (auto ItOut = Entry.Instance->Outputs.itfront(); bDone && ItOut; ++ItOut)
+		{
+			bDone = (*ItOut).ComputedQueued == 0;
+		}
+
+		if (bDone)
+		{
+			Completed.push(Entry.Instance);
+			InFlightFootprint -= Entry.Footprint;
+			InFlight.RemoveAt(Idx);
+			--FirstUnlaunched;
+			++RetiredCount;
+		}
+		else
+		{
+			++Idx;
+		}
+	}
+
+	SET_MEMORY_STAT(STAT_SubstanceSchedulerFootprint, InFlightFootprint);
+	SET_DWORD_STAT(STAT_SubstanceSchedulerInFlight, InFlight.Num());
+
+	return RetiredCount;
+}
+
+void RenderScheduler::Remove(graph_inst_t* Instance)
+{
+	// an instance queued again while in flight has several entries
+	for (int32 Idx = InFlight.Num() - 1; Idx >= 0; --Idx)
+	{
+		if (InFlight[Idx].Instance == Instance)
+		{
+			InFlightFootprint -= InFlight[Idx].Footprint;
+			InFlight.RemoveAt(Idx);
+
+			if (Idx < FirstUnlaunched)
+			{
+				--FirstUnlaunched;
+			}
+		}
+	}
+
+	SET_MEMORY_STAT(STAT_SubstanceSchedulerFootprint, InFlightFootprint);
+	SET_DWORD_STAT(STAT_SubstanceSchedulerInFlight, InFlight.Num());
+}
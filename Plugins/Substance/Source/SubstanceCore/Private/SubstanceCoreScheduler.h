@@ -0,0 +1,70 @@
+//! @file SubstanceCoreScheduler.h
+//! @brief Memory budget aware scheduling of runtime Substance renders
+//! @date 20150319
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "framework/renderfuture.h"
+
+namespace Substance
+{
+	//! @brief Admits queued graph instances to the renderer while their
+	//! estimated outputs footprint fits in the memory budget, and retires
+	//! them one by one as their outputs complete: the pipeline stays full
+	//! instead of waiting for a whole batch.
+	class RenderScheduler
+	{
+	public:
+		RenderScheduler();
+
+		//! @brief Estimate the memory footprint of the enabled outputs of an
+		//!		instance, from their formats, $outputsize and full mip chain
+		static SIZE_T EstimateFootprint(graph_inst_t* Instance);
+
+		//! @brief Move instances from a queue while the budget allows
+		//! @param Queue Instances waiting for rendering, popped from the back
+		//! @param Admitted Receive the admitted instances, to push and run
+		//! @return Return the count of admitted instances
+		//! @note At least one instance is admitted if nothing is in flight
+		int32 Admit(
+			Substance::List<graph_inst_t*>& Queue,
+			Substance::List<graph_inst_t*>& Admitted);
+
+		//! @brief Set the run of the instances admitted since last call
+		//! @param Future Handle returned by Renderer::runAsync()
+		void Launch(const RenderFuture::SPtr& Future);
+
+		//! @brief Retire the instances w/ run done and outputs grabbed
+		//! @param Completed Receive the retired instances
+		//! @return Return the count of retired instances
+		int32 Retire(Substance::List<graph_inst_t*>& Completed);
+
+		//! @brief Forget all the runs of an instance (deleted instance)
+		void Remove(graph_inst_t* Instance);
+
+		//! @brief Return true if no instance is in flight
+		bool IsIdle() const { return InFlight.Num() == 0; }
+
+	private:
+		//! @brief Instance admitted to the renderer
+		struct FInFlight
+		{
+			graph_inst_t* Instance;
+
+			//! @brief Renderer run completion, NULL if not launched
+			RenderFuture::SPtr Future;
+
+			//! @brief Estimated footprint, in bytes
+			SIZE_T Footprint;
+		};
+
+		//! @brief Instances admitted, in admission order
+		TArray<FInFlight> InFlight;
+
+		//! @brief Sum of in flight instances footprints, in bytes
+		SIZE_T InFlightFootprint;
+
+		//! @brief Index of the first instance not yet launched
+		int32 FirstUnlaunched;
+	};
+}
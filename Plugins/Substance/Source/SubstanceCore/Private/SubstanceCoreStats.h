@@ -0,0 +1,9 @@
+//! @file SubstanceCoreStats.h
+//! @brief Substance stats group, shared by all the plugin stats
+//! @date 20150312
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("Substance"), STATGROUP_Substance, STATCAT_Advanced);
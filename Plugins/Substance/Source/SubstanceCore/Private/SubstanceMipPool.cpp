@@ -0,0 +1,119 @@
+//! @file SubstanceMipPool.cpp
+//! @brief Size class pool of the mip buffers used for texture uploads
+//! @date 20150325
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceMipPool.h"
+#include "SubstanceCoreStats.h"
+
+DECLARE_MEMORY_STAT(TEXT("Mip Pool Memory"), STAT_SubstanceMipPoolBytes, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mip Pool Hits"), STAT_SubstanceMipPoolHits, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mip Pool Misses"), STAT_SubstanceMipPoolMisses, STATGROUP_Substance);
+
+namespace
+{
+	//! @brief Pooled memory above which freed buffers are released
+	const SIZE_T MaxPooledBytes = 128 * 1024 * 1024;
+}
+
+using namespace Substance;
+
+MipBufferPool::MipBufferPool()
+	: PooledBytes(0)
+{
+}
+
+MipBufferPool& MipBufferPool::Get()
+{
+	static MipBufferPool Pool;
+	return Pool;
+}
+
+int32 MipBufferPool::GetSizeClass(SIZE_T Size)
+{
+	int32 ClassLog2 = MinClassLog2;
+
+	while (ClassLog2 <= MaxClassLog2 && ((SIZE_T)1 << ClassLog2) < Size)
+	{
+		++ClassLog2;
+	}
+
+	return ClassLog2 - MinClassLog2;
+}
+
+uint8* MipBufferPool::Alloc(SIZE_T Size)
+{
+	const int32 SizeClass = GetSizeClass(Size);
+
+	if (SizeClass >= NumClasses)
+	{
+		INC_DWORD_STAT(STAT_SubstanceMipPoolMisses);
+		return (uint8*)FMemory::Malloc(Size);
+	}
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		if (FreeLists[SizeClass].Num() != 0)
+		{
+			PooledBytes -= (SIZE_T)1 << (SizeClass + MinClassLog2);
+			SET_MEMORY_STAT(STAT_SubstanceMipPoolBytes, PooledBytes);
+			INC_DWORD_STAT(STAT_SubstanceMipPoolHits);
+
+			return FreeLists[SizeClass].Pop();
+		}
+	}
+
+	INC_DWORD_STAT(STAT_SubstanceMipPoolMisses);
+
+	return (uint8*)FMemory::Malloc((SIZE_T)1 << (SizeClass + MinClassLog2));
+}
+
+void MipBufferPool::Free(uint8* Buffer, SIZE_T Size)
+{
+	if (NULL == Buffer)
+	{
+		return;
+	}
+
+	const int32 SizeClass = GetSizeClass(Size);
+
+	if (SizeClass < NumClasses)
+	{
+		const SIZE_T ClassSize = (SIZE_T)1 << (SizeClass + MinClassLog2);
+
+		FScopeLock Lock(&Mutex);
+
+		if (PooledBytes + ClassSize <= MaxPooledBytes)
+		{
+			FreeLists[SizeClass].Push(Buffer);
+			PooledBytes += ClassSize;
+			SET_MEMORY_STAT(STAT_SubstanceMipPoolBytes, PooledBytes);
+			return;
+		}
+	}
+
+	FMemory::Free(Buffer);
+}
+
+SIZE_T MipBufferPool::Trim()
+{
+	FScopeLock Lock(&Mutex);
+
+	const SIZE_T FreedBytes = PooledBytes;
+
+	for (int32 SizeClass = 0; SizeClass < NumClasses; ++SizeClass)
+	{
+		for (int32 Idx = 0; Idx < FreeLists[SizeClass].Num(); ++Idx)
+		{
+			FMemory::Free(FreeLists[SizeClass][Idx]);
+		}
+
+		FreeLists[SizeClass].Empty();
+	}
+
+	PooledBytes = 0;
+	SET_MEMORY_STAT(STAT_SubstanceMipPoolBytes, PooledBytes);
+
+	return FreedBytes;
+}
@@ -0,0 +1,57 @@
+//! @file SubstanceMipPool.h
+//! @brief Size class pool of the mip buffers used for texture uploads
+//! @date 20150325
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Recycles the mip buffers of the uploads: re-rendered outputs
+	//! get back the buffers of their previous upload instead of allocating.
+	//! Buffers are pooled per power of two size class.
+	//! @note Thread safe: buffers are allocated by the game thread and
+	//!		freed by the render thread
+	class MipBufferPool
+	{
+	public:
+		MipBufferPool();
+
+		//! @brief Return the shared pool
+		static MipBufferPool& Get();
+
+		//! @brief Allocate a buffer, from the pool if one is free
+		//! @param Size Size in bytes, the buffer can be larger
+		uint8* Alloc(SIZE_T Size);
+
+		//! @brief Give a buffer back to the pool
+		//! @param Size The size passed to Alloc()
+		void Free(uint8* Buffer, SIZE_T Size);
+
+		//! @brief Release all the pooled buffers
+		//! @return Return the count of bytes freed
+		SIZE_T Trim();
+
+	private:
+		//! @brief Size classes: 4KB to 64MB, larger buffers are not pooled
+		enum
+		{
+			MinClassLog2 = 12,
+			MaxClassLog2 = 26,
+			NumClasses = MaxClassLog2 - MinClassLog2 + 1
+		};
+
+		//! @brief Return the size class of a size, NumClasses if too large
+		static int32 GetSizeClass(SIZE_T Size);
+
+		//! @brief Free buffers, per size class
+		TArray<uint8*> FreeLists[NumClasses];
+
+		//! @brief Sum of the free buffers sizes
+		SIZE_T PooledBytes;
+
+		FCriticalSection Mutex;
+
+		MipBufferPool(const MipBufferPool&);
+		MipBufferPool& operator=(const MipBufferPool&);
+	};
+}
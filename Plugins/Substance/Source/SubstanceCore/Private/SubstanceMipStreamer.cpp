@@ -0,0 +1,196 @@
+//! @file SubstanceMipStreamer.cpp
+//! @brief On demand generation of the high mips of runtime Substance outputs
+//! @date 20150324
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceMipStreamer.h"
+#include "SubstanceCache.h"
+#include "SubstanceCoreHelpers.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceFGraph.h"
+#include "SubstanceFOutput.h"
+#include "SubstanceInput.h"
+#include "SubstanceSettings.h"
+#include "SubstanceTexture2D.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mip Streamer Reduced Instances"), STAT_SubstanceMipStreamerReduced, STATGROUP_Substance);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Mip Streamer Promotions"), STAT_SubstanceMipStreamerPromotions, STATGROUP_Substance);
+
+namespace
+{
+	//! @brief A texture drawn during this period is requesting higher mips
+	const double VisibleSeconds = 1.0;
+
+	//! @brief Return the $outputsize input of an instance, NULL if none
+	FNumericalInputInstance<vec2int_t>* FindOutputSize(graph_inst_t* Instance)
+	{
+		for (auto ItIn = Instance->Inputs.itfront(); ItIn; ++ItIn)
+		{
+			input_inst_t* Input = ItIn->Get();
+
+			if (Input && 
+				Input->Desc->Type == Substance_IType_Integer2 &&
+				Input->Desc->Identifier == TEXT("$outputsize"))
+			{
+				return (FNumericalInputInstance<vec2int_t>*)Input;
+			}
+		}
+
+		return NULL;
+	}
+
+	void SetOutputSize(graph_inst_t* Instance, const vec2int_t& Size)
+	{
+		TArray<int32> Value;
+		Value.Add(Size.X);
+		Value.Add(Size.Y);
+
+		Instance->UpdateInput(FString(TEXT("$outputsize")), Value);
+	}
+
+	//! @brief Return true if a texture of the instance was drawn recently
+	bool IsVisible(graph_inst_t* Instance, double Now)
+	{
+		for (auto ItOut = Instance->Outputs.itfront(); ItOut; ++ItOut)
+		{
+			USubstanceTexture2D* Texture = *(*ItOut).Texture.get();
+
+			if (Texture && Texture->Resource && 
+				Now - Texture->Resource->LastRenderTime < VisibleSeconds)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+using namespace Substance;
+
+MipStreamer::MipStreamer()
+{
+}
+
+void MipStreamer::Clamp(Substance::List<graph_inst_t*>& Queue)
+{
+	const USubstanceSettings* Settings = GetDefault<USubstanceSettings>();
+
+	if (!Settings->bGenerateMipsOnDemand)
+	{
+		return;
+	}
+
+	for (auto ItInst = Queue.itfront(); ItInst; ++ItInst)
+	{
+		graph_inst_t* Instance = *ItInst;
+		FNumericalInputInstance<vec2int_t>* Input = FindOutputSize(Instance);
+
+		if (NULL == Input)
+		{
+			continue;
+		}
+
+		FEntry* Entry = Entries.Find(Instance);
+
+		if (Entry && Entry->Current == Input->Value)
+		{
+			// render of the current (or promoted) size
+			Entry->bPending = true;
+			continue;
+		}
+
+		// new instance or size set by gameplay: reduce from the new target
+		FEntry NewEntry;
+		NewEntry.Target = Input->Value;
+		NewEntry.bPending = true;
+
+		const int32 Reduction = FMath::Max(
+			FMath::Max(NewEntry.Target.X, NewEntry.Target.Y) - Settings->InitialMipSizeLog2,
+			0);
+
+		NewEntry.Current.X = FMath::Max(NewEntry.Target.X - Reduction, 0);
+		NewEntry.Current.Y = FMath::Max(NewEntry.Target.Y - Reduction, 0);
+
+		if (NewEntry.Current == NewEntry.Target)
+		{
+			Entries.Remove(Instance);
+			continue;
+		}
+
+		Entries.Add(Instance, NewEntry);
+		SetOutputSize(Instance, NewEntry.Current);
+	}
+
+	SET_DWORD_STAT(STAT_SubstanceMipStreamerReduced, Entries.Num());
+}
+
+void MipStreamer::Rendered(Substance::List<graph_inst_t*>& Completed)
+{
+	for (auto ItInst = Completed.itfront(); ItInst; ++ItInst)
+	{
+		FEntry* Entry = Entries.Find(*ItInst);
+
+		if (Entry)
+		{
+			Entry->bPending = false;
+
+			if (Entry->Current == Entry->Target)
+			{
+				Entries.Remove(*ItInst);
+			}
+		}
+	}
+
+	SET_DWORD_STAT(STAT_SubstanceMipStreamerReduced, Entries.Num());
+}
+
+int32 MipStreamer::Update()
+{
+	const double Now = FApp::GetCurrentTime();
+	int32 PromotedCount = 0;
+
+	for (auto ItEntry = Entries.CreateIterator(); ItEntry; ++ItEntry)
+	{
+		graph_inst_t* Instance = ItEntry.Key();
+		FEntry& Entry = ItEntry.Value();
+
+		// not queued when read from cache, bPending is not set
+		if (Entry.bPending || SubstanceCache::Get()->IsReading(Instance))
+		{
+			continue;
+		}
+
+		if (Entry.Current == Entry.Target)
+		{
+			// target reached w/o render (read from cache)
+			ItEntry.RemoveCurrent();
+			continue;
+		}
+
+		if (!IsVisible(Instance, Now))
+		{
+			continue;
+		}
+
+		// one mip level per render, the ratio of the target is kept. Pending
+		// is set back by Clamp() once queued (not queued if read from cache)
+		Entry.Current.X = FMath::Min(Entry.Current.X + 1, Entry.Target.X);
+		Entry.Current.Y = FMath::Min(Entry.Current.Y + 1, Entry.Target.Y);
+
+		SetOutputSize(Instance, Entry.Current);
+		Helpers::RenderVisible(Instance);
+
+		INC_DWORD_STAT(STAT_SubstanceMipStreamerPromotions);
+		++PromotedCount;
+	}
+
+	SET_DWORD_STAT(STAT_SubstanceMipStreamerReduced, Entries.Num());
+
+	return PromotedCount;
+}
+
+void MipStreamer::Remove(graph_inst_t* Instance)
+{
+	Entries.Remove(Instance);
+}
@@ -0,0 +1,53 @@
+//! @file SubstanceMipStreamer.h
+//! @brief On demand generation of the high mips of runtime Substance outputs
+//! @date 20150324
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+namespace Substance
+{
+	//! @brief Renders runtime instances at a reduced $outputsize first, then
+	//! raises it one mip level at a time while their textures are drawn.
+	//! Dynamic textures are not handled by the texture streaming manager:
+	//! the render time of the texture resources is the demand signal.
+	//! @note $outputsize is a graph input, all the outputs of an instance
+	//!		are promoted together.
+	class MipStreamer
+	{
+	public:
+		MipStreamer();
+
+		//! @brief Reduce the $outputsize of instances about to be rendered
+		//! @param Queue Instances waiting for rendering
+		//! @note A $outputsize changed by gameplay becomes the new target
+		void Clamp(Substance::List<graph_inst_t*>& Queue);
+
+		//! @brief Notify instances whose render is complete
+		void Rendered(Substance::List<graph_inst_t*>& Completed);
+
+		//! @brief Promote the reduced instances drawn recently, called once
+		//!		per frame
+		//! @return Return the count of instances queued for a higher size
+		int32 Update();
+
+		//! @brief Forget an instance (deleted instance)
+		void Remove(graph_inst_t* Instance);
+
+	private:
+		//! @brief Reduced instance
+		struct FEntry
+		{
+			//! @brief $outputsize requested by the instance (log2)
+			vec2int_t Target;
+
+			//! @brief $outputsize currently rendered (log2)
+			vec2int_t Current;
+
+			//! @brief Render in progress at the current size
+			bool bPending;
+		};
+
+		//! @brief Reduced instances, until they reach their target
+		TMap<graph_inst_t*, FEntry> Entries;
+	};
+}
@@ -4,11 +4,37 @@
 #include "SubstanceInstanceFactory.h"
 #include "SubstanceSettings.h"
 
+#include "framework/renderopt.h"
+
 USubstanceSettings::USubstanceSettings(const FObjectInitializer& PCIP)
 	: Super(PCIP)
 	, MemoryBudgetMb(256)
 	, CPUCores(2)
+	, RenderWorkers(1)
+	, bAdaptiveCores(false)
+	, FrameTimeTargetMs(16.6f)
+	, OutputUploadBudgetMs(2.0f)
+	, OutputUploadBudgetKb(0)
+	, TextureUploadBudgetKb(16384)
+	, bCompressRawOutputs(false)
+	, bGenerateMipsOnDemand(false)
+	, InitialMipSizeLog2(7)
+	, bCacheLinkedBinaries(true)
+	, LinkCacheMaxSizeMb(256)
+	, bCompressCacheEntries(true)
+	, CacheMaxSizeMb(2048)
 	, AsyncLoadMipClip(3)
 {
 
 }
+
+
+#if WITH_EDITOR
+void USubstanceSettings::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// renderers reload their options at next job boundary
+	Substance::RenderOptions::notifySettingsChanged();
+}
+#endif
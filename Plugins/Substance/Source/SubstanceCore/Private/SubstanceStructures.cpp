@@ -4,6 +4,7 @@
 //! @copyright Allegorithmic. All rights reserved.
 
 #include "SubstanceCorePrivatePCH.h"
+#include "SubstanceCache.h"
 #include "SubstanceCoreHelpers.h"
 #include "SubstanceFOutput.h"
 #include "SubstanceFGraph.h"
@@ -60,13 +61,17 @@ FOutputInstance::FOutputInstance():
 	OutputGuid(FGuid::NewGuid()),
 	bIsEnabled(false),
 	bIsDirty(true),
-	Texture(std::shared_ptr<USubstanceTexture2D*>(new USubstanceTexture2D*))
+	Texture(std::shared_ptr<USubstanceTexture2D*>(new USubstanceTexture2D*)),
+	ComputedQueued(0),
+	ComputedNext(NULL)
 {
 	*(Texture.get()) = NULL;
 }
 
 
-FOutputInstance::FOutputInstance(const FOutputInstance& Other)
+FOutputInstance::FOutputInstance(const FOutputInstance& Other) :
+	ComputedQueued(0),
+	ComputedNext(NULL)
 {
 	Uid = Other.Uid;
 	Format = Other.Format;
@@ -89,6 +94,7 @@ FOutputInstance::FOutputInstance(const FOutputInstance& Other)
 
 FOutputInstance::~FOutputInstance()
 {
+	SubstanceCache::ForgetOutput(this);
 	RenderCallbacks::clearComputedOutputs(this);
 	RenderTokens.clear();
 }
@@ -157,6 +163,7 @@ bool FOutputInstance::queueRender()
 	bool res = bIsDirty;
 	bIsDirty = false;
 	(*Texture)->OutputCopy->bIsDirty = true;
+
 	return res;
 }
 
@@ -12,6 +12,7 @@
 #include "SubstanceTexture2D.h"
 #include "SubstanceSettings.h"
 #include "SubstanceTexture2DDynamicResource.h"
+#include "SubstanceTextureUpload.h"
 
 #if WITH_EDITOR
 #include "ObjectTools.h"
@@ -21,7 +22,12 @@
 
 DEFINE_LOG_CATEGORY_STATIC(LogSubstanceTexture, Warning, All);
 
+/** Grey texture shown by all the outputs waiting for their first render. */
+TGlobalResource<FSubstancePlaceholderTexture> GSubstancePlaceholderTexture;
+
+
 USubstanceTexture2D::USubstanceTexture2D(class FObjectInitializer const & PCIP) : Super(PCIP)
+	, bUsePlaceholder(false)
 {
 
 }
@@ -322,7 +328,7 @@ SIZE_T USubstanceTexture2D::GetResourceSize(EResourceSizeMode::Type Mode)
 
 FTextureResource* USubstanceTexture2D::CreateResource()
 {
-	if (Mips.Num())
+	if (Mips.Num() || bUsePlaceholder)
 	{
 		return new FSubstanceTexture2DDynamicResource(this);
 	}
@@ -337,64 +343,30 @@ void USubstanceTexture2D::UpdateResource()
 
 	if( Resource )
 	{
-		struct FUpdateSubstanceTexture
-		{
-			FTexture2DDynamicResource* Resource;
-			USubstanceTexture2D* Owner;
-		};
-
-		FUpdateSubstanceTexture* SubstanceData = new FUpdateSubstanceTexture;
-
-		SubstanceData->Resource = (FTexture2DDynamicResource*)Resource;
-		SubstanceData->Owner = this;
+		output_inst_t* Output = (OutputCopy && ParentInstance && ParentInstance->Instance) ?
+			ParentInstance->Instance->GetOutput(OutputCopy->Uid) : NULL;
 
-		ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
-			UpdateSubstanceTexture,
-			FUpdateSubstanceTexture*,SubstanceData,SubstanceData,
+		if (Output && Mips.Num() && 0 == Mips[0].BulkData.GetBulkDataSize())
 		{
-			// Read the resident mip-levels into the RHI texture.
-			for( int32 MipIndex=0; MipIndex<SubstanceData->Owner->Mips.Num(); MipIndex++ )
-			{
-				uint32 DestPitch;
-				void* TheMipData = RHILockTexture2D( SubstanceData->Resource->GetTexture2DRHI(), MipIndex, RLM_WriteOnly, DestPitch, false );
-
-				FTexture2DMipMap& MipMap = SubstanceData->Owner->Mips[MipIndex];
-
-				// for platforms that returned 0 pitch from Lock, we need to just use the bulk data directly, never do 
-				// runtime block size checking, conversion, or the like
-				if (DestPitch == 0)
-				{
-					FMemory::Memcpy(TheMipData, MipMap.BulkData.Lock(LOCK_READ_ONLY), MipMap.BulkData.GetBulkDataSize());
-				}
-				else
-				{
-					EPixelFormat PixelFormat = SubstanceData->Owner->Format;
-					const uint32 BlockSizeX = GPixelFormats[PixelFormat].BlockSizeX;		// Block width in pixels
-					const uint32 BlockSizeY = GPixelFormats[PixelFormat].BlockSizeY;		// Block height in pixels
-					const uint32 BlockBytes = GPixelFormats[PixelFormat].BlockBytes;
-					uint32 NumColumns		= (MipMap.SizeX + BlockSizeX - 1) / BlockSizeX;	// Num-of columns in the source data (in blocks)
-					uint32 NumRows			= (MipMap.SizeY + BlockSizeY - 1) / BlockSizeY;	// Num-of rows in the source data (in blocks)
-					if ( PixelFormat == PF_PVRTC2 || PixelFormat == PF_PVRTC4 )
-					{
-						// PVRTC has minimum 2 blocks width and height
-						NumColumns = FMath::Max<uint32>(NumColumns, 2);
-						NumRows = FMath::Max<uint32>(NumRows, 2);
-					}
-					const uint32 SrcPitch   = NumColumns * BlockBytes;						// Num-of bytes per row in the source data
-					const uint32 EffectiveSize = BlockBytes*NumColumns*NumRows;
-
-					// Copy the texture data.
-					CopyTextureData2D(MipMap.BulkData.Lock(LOCK_READ_ONLY),TheMipData,MipMap.SizeY,PixelFormat,SrcPitch,DestPitch);
-				}
+			// mips were uploaded from the render result, not kept: the
+			// content of the new resource has to be rendered again
+			Output->flagAsDirty();
+			Substance::Helpers::RenderAsync(ParentInstance->Instance);
+			return;
+		}
 
-				MipMap.BulkData.Unlock();
+		// upload from a copy of the mips: they can be changed by the game
+		// thread before the render command is executed
+		Substance::TextureUploadBatch Batch;
+		Batch.Add(this);
+		Batch.Submit();
+	}
+}
 
-				RHIUnlockTexture2D( SubstanceData->Resource->GetTexture2DRHI(), MipIndex, false );
-			}
 
-			delete SubstanceData;
-		});
-	}
+void USubstanceTexture2D::RecreateResource()
+{
+	Super::UpdateResource();
 }
 
 
@@ -436,7 +408,16 @@ void FSubstanceTexture2DDynamicResource::CreateSamplerStates(float MipMapBias)
 void FSubstanceTexture2DDynamicResource::InitRHI()
 {
 	// Create the sampler state RHI resource.
-	CreateSamplerStates(UTexture2D::GetGlobalMipMapLODBias() + ((SubstanceOwner->LODGroup == TEXTUREGROUP_UI) ? -SubstanceOwner->Mips.Num() : 0));
+	CreateSamplerStates(UTexture2D::GetGlobalMipMapLODBias() + ((SubstanceOwner->LODGroup == TEXTUREGROUP_UI) ? -NumMips : 0));
+
+	if (0 == NumMips)
+	{
+		// no content yet, the placeholder is shared by all the outputs
+		Texture2DRHI = GSubstancePlaceholderTexture.GetTexture2DRHI();
+		TextureRHI = Texture2DRHI;
+		RHIUpdateTextureReference(SubstanceOwner->TextureReference.TextureReferenceRHI, TextureRHI);
+		return;
+	}
 
 	uint32 Flags = 0;
 	if (SubstanceOwner->bIsResolveTarget)
@@ -460,7 +441,7 @@ void FSubstanceTexture2DDynamicResource::InitRHI()
 		Flags |= TexCreate_NoTiling;
 	}
 	FRHIResourceCreateInfo CreateInfo;
-	Texture2DRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), SubstanceOwner->Format, SubstanceOwner->NumMips, 1, Flags, CreateInfo);
+	Texture2DRHI = RHICreateTexture2D(GetSizeX(), GetSizeY(), Format, NumMips, 1, Flags, CreateInfo);
 	TextureRHI = Texture2DRHI;
 	RHIUpdateTextureReference(SubstanceOwner->TextureReference.TextureReferenceRHI, TextureRHI);
 }
@@ -469,6 +450,9 @@ void FSubstanceTexture2DDynamicResource::InitRHI()
 /** Called when the resource is released. This is only called by the rendering thread. */
 void FSubstanceTexture2DDynamicResource::ReleaseRHI()
 {
+	// uploads carried over to next frames must not use this resource
+	Substance::TextureUploadBatch::Cancel(this);
+
 	RHIUpdateTextureReference(SubstanceOwner->TextureReference.TextureReferenceRHI, FTextureRHIParamRef());
 	FTextureResource::ReleaseRHI();
 	Texture2DRHI.SafeRelease();
@@ -481,3 +465,92 @@ FTexture2DRHIRef FSubstanceTexture2DDynamicResource::GetTexture2DRHI()
 	return Texture2DRHI;
 }
 
+
+/** Copy the content of a mip into the RHI texture. This is only called by the rendering thread. */
+void FSubstanceTexture2DDynamicResource::UpdateMip(int32 MipIndex, int32 MipSizeX, int32 MipSizeY, const void* Data, SIZE_T DataSize)
+{
+	// never write in the shared placeholder
+	check(NumMips > 0);
+
+	uint32 DestPitch;
+	void* TheMipData = RHILockTexture2D( Texture2DRHI, MipIndex, RLM_WriteOnly, DestPitch, false );
+
+	// for platforms that returned 0 pitch from Lock, we need to just use the bulk data directly, never do 
+	// runtime block size checking, conversion, or the like
+	if (DestPitch == 0)
+	{
+		FMemory::Memcpy(TheMipData, Data, DataSize);
+	}
+	else
+	{
+		const uint32 BlockSizeX = GPixelFormats[Format].BlockSizeX;		// Block width in pixels
+		const uint32 BlockSizeY = GPixelFormats[Format].BlockSizeY;		// Block height in pixels
+		const uint32 BlockBytes = GPixelFormats[Format].BlockBytes;
+		uint32 NumColumns		= (MipSizeX + BlockSizeX - 1) / BlockSizeX;	// Num-of columns in the source data (in blocks)
+		uint32 NumRows			= (MipSizeY + BlockSizeY - 1) / BlockSizeY;	// Num-of rows in the source data (in blocks)
+		if ( Format == PF_PVRTC2 || Format == PF_PVRTC4 )
+		{
+			// PVRTC has minimum 2 blocks width and height
+			NumColumns = FMath::Max<uint32>(NumColumns, 2);
+			NumRows = FMath::Max<uint32>(NumRows, 2);
+		}
+		const uint32 SrcPitch   = NumColumns * BlockBytes;						// Num-of bytes per row in the source data
+
+		// Copy the texture data.
+		CopyTextureData2D(Data,TheMipData,MipSizeY,Format,SrcPitch,DestPitch);
+	}
+
+	RHIUnlockTexture2D( Texture2DRHI, MipIndex, false );
+}
+
+
+/** Copy rows of a mip into the RHI texture, w/o locking it. This is only called by the rendering thread. */
+void FSubstanceTexture2DDynamicResource::UpdateMipRows(int32 MipIndex, int32 MipSizeX, int32 FirstRow, int32 NumRows, const void* Data)
+{
+	check(SupportsRegionUpdate() && NumMips > 0);
+
+	const uint32 SrcPitch = MipSizeX * GPixelFormats[Format].BlockBytes;
+	const FUpdateTextureRegion2D Region(0, FirstRow, 0, 0, MipSizeX, NumRows);
+
+	RHIUpdateTexture2D(Texture2DRHI, MipIndex, Region, SrcPitch, (const uint8*)Data);
+}
+
+
+/** Called when the resource is initialized. This is only called by the rendering thread. */
+void FSubstancePlaceholderTexture::InitRHI()
+{
+	FRHIResourceCreateInfo CreateInfo;
+	Texture2DRHI = RHICreateTexture2D(Size, Size, PF_B8G8R8A8, NumMips, 1, 0, CreateInfo);
+	TextureRHI = Texture2DRHI;
+
+	// mid grey, transparent
+	for (uint32 MipIndex = 0; MipIndex < NumMips; ++MipIndex)
+	{
+		const uint32 MipSize = Size >> MipIndex;
+		uint32 DestPitch;
+		uint8* TheMipData = (uint8*)RHILockTexture2D(Texture2DRHI, MipIndex, RLM_WriteOnly, DestPitch, false);
+
+		for (uint32 Y = 0; Y < MipSize; ++Y)
+		{
+			uint32* Pixels = (uint32*)(TheMipData + Y * DestPitch);
+
+			for (uint32 X = 0; X < MipSize; ++X)
+			{
+				Pixels[X] = FColor(128, 128, 128, 0).DWColor();
+			}
+		}
+
+		RHIUnlockTexture2D(Texture2DRHI, MipIndex, false);
+	}
+
+	FSamplerStateInitializerRHI SamplerStateInitializer(SF_Bilinear, AM_Wrap, AM_Wrap, AM_Wrap);
+	SamplerStateRHI = RHICreateSamplerState(SamplerStateInitializer);
+}
+
+
+/** Called when the resource is released. This is only called by the rendering thread. */
+void FSubstancePlaceholderTexture::ReleaseRHI()
+{
+	FTexture::ReleaseRHI();
+	Texture2DRHI.SafeRelease();
+}
@@ -7,14 +7,71 @@
 
 #include "TextureResource.h"
 
+/** Grey texture shared by the Substance textures that have no content yet. */
+class FSubstancePlaceholderTexture : public FTexture
+{
+public:
+	enum
+	{
+		Size = 16,
+		NumMips = 4
+	};
+
+	/** Returns the width of the texture in pixels. */
+	virtual uint32 GetSizeX() const override
+	{
+		return Size;
+	}
+
+	/** Returns the height of the texture in pixels. */
+	virtual uint32 GetSizeY() const override
+	{
+		return Size;
+	}
+
+	/** Called when the resource is initialized. This is only called by the rendering thread. */
+	virtual void InitRHI() override;
+
+	/** Called when the resource is released. This is only called by the rendering thread. */
+	virtual void ReleaseRHI() override;
+
+	/** Returns the Texture2DRHI shared by the placeholder resources. */
+	FTexture2DRHIRef GetTexture2DRHI() const
+	{
+		return Texture2DRHI;
+	}
+
+private:
+	FTexture2DRHIRef Texture2DRHI;
+};
+
+extern TGlobalResource<FSubstancePlaceholderTexture> GSubstancePlaceholderTexture;
+
+
 /** A dynamic 2D texture resource. */
 class FSubstanceTexture2DDynamicResource : public FTextureResource
 {
 public:
 	/** Initialization constructor. */
 	FSubstanceTexture2DDynamicResource(class USubstanceTexture2D* InOwner) : 
-		SubstanceOwner(InOwner)
+		SubstanceOwner(InOwner),
+		SizeX(0),
+		SizeY(0),
+		NumMips(InOwner->Mips.Num()),
+		Format(InOwner->Format)
 	{
+		// the owner mips can be rebuilt by the game thread before InitRHI
+		if (NumMips)
+		{
+			SizeX = SubstanceOwner->Mips[0].SizeX;
+			SizeY = SubstanceOwner->Mips[0].SizeY;
+		}
+		else
+		{
+			// no mips, uses the shared placeholder
+			SizeX = SizeY = FSubstancePlaceholderTexture::Size;
+		}
+
 		if (SubstanceOwner->Format == PF_G8 || 
 			SubstanceOwner->Format == PF_G16)
 		{
@@ -25,23 +82,13 @@ public:
 	/** Returns the width of the texture in pixels. */
 	virtual uint32 GetSizeX() const override
 	{
-		if (SubstanceOwner && SubstanceOwner->Mips.Num())
-		{
-			return SubstanceOwner->Mips[0].SizeX;
-		}
-
-		return 0;
+		return SizeX;
 	}
 
 	/** Returns the height of the texture in pixels. */
 	virtual uint32 GetSizeY() const override
 	{
-		if (SubstanceOwner && SubstanceOwner->Mips.Num())
-		{
-			return SubstanceOwner->Mips[0].SizeY;
-		}
-
-		return 0;
+		return SizeY;
 	}
 
 	/** Create RHI sampler states. */
@@ -56,8 +103,26 @@ public:
 	/** Returns the Texture2DRHI, which can be used for locking/unlocking the mips. */
 	FTexture2DRHIRef GetTexture2DRHI();
 
+	/** Copy the content of a mip into the RHI texture. This is only called by the rendering thread. */
+	void UpdateMip(int32 MipIndex, int32 MipSizeX, int32 MipSizeY, const void* Data, SIZE_T DataSize);
+
+	/** Returns true if mips can be updated by regions of rows, only for uncompressed formats. */
+	bool SupportsRegionUpdate() const
+	{
+		return GPixelFormats[Format].BlockSizeX == 1 && GPixelFormats[Format].BlockSizeY == 1;
+	}
+
+	/** Copy rows of a mip into the RHI texture, w/o locking it. This is only called by the rendering thread. */
+	void UpdateMipRows(int32 MipIndex, int32 MipSizeX, int32 FirstRow, int32 NumRows, const void* Data);
+
 private:
 	USubstanceTexture2D* SubstanceOwner;
 
 	FTexture2DRHIRef Texture2DRHI;
+
+	/** Size, mips count and format at creation, the owner can change them before InitRHI */
+	uint32 SizeX;
+	uint32 SizeY;
+	int32 NumMips;
+	EPixelFormat Format;
 };
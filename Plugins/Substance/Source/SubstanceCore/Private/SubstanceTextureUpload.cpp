@@ -0,0 +1,391 @@
+//! @file SubstanceTextureUpload.cpp
+//! @brief Batched upload of the Substance textures mips
+//! @date 20150323
+//! @copyright Allegorithmic. All rights reserved.
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceTextureUpload.h"
+#include "SubstanceCoreStats.h"
+#include "SubstanceMipPool.h"
+#include "SubstanceSettings.h"
+#include "SubstanceTexture2D.h"
+#include "SubstanceTexture2DDynamicResource.h"
+
+#include "framework/renderresult.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Uploaded Textures"), STAT_SubstanceUploadedTextures, STATGROUP_Substance);
+DECLARE_MEMORY_STAT(TEXT("Uploaded Memory"), STAT_SubstanceUploadedBytes, STATGROUP_Substance);
+DECLARE_CYCLE_STAT(TEXT("Upload Textures (RT)"), STAT_SubstanceUploadTextures, STATGROUP_Substance);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Carried Over Uploads"), STAT_SubstanceCarriedOverUploads, STATGROUP_Substance);
+
+using namespace Substance;
+
+namespace
+{
+	//! @brief Batches not completely uploaded, in submit order (render thread)
+	TArray<TextureUploadBatch::FUploads*> GPendingBatches;
+
+	//! @brief Count of pending batches, read by the game thread
+	FThreadSafeCounter GPendingBatchesCount;
+
+	//! @brief Upload, mip and row to resume the first pending batch at
+	int32 GResumeUpload = 0;
+	int32 GResumeMip = 0;
+	int32 GResumeRow = 0;
+
+	//! @brief Bytes uploaded during the current render thread frame
+	uint32 GBudgetFrame = 0;
+	SIZE_T GBudgetUsed = 0;
+}
+
+TextureUploadBatch::TextureUploadBatch()
+	: Staged(NULL)
+{
+}
+
+TextureUploadBatch::~TextureUploadBatch()
+{
+	// nothing is referenced by submitted batches, they can outlive this one
+	delete Staged;
+}
+
+TextureUploadBatch::FTextureUpload::FTextureUpload()
+	: Texture(NULL)
+	, Resource(NULL)
+	, Result(NULL)
+{
+}
+
+TextureUploadBatch::FTextureUpload::~FTextureUpload()
+{
+	Reset();
+}
+
+void TextureUploadBatch::FTextureUpload::Reset()
+{
+	// can be the render thread, the engine buffer release is deferred
+	delete Result;
+	Result = NULL;
+
+	for (int32 IdxMip = 0; IdxMip < Mips.Num(); ++IdxMip)
+	{
+		MipBufferPool::Get().Free(Mips[IdxMip].Data, Mips[IdxMip].Size);
+	}
+
+	Mips.Empty();
+}
+
+const uint8* TextureUploadBatch::FTextureUpload::GetMipData(int32 IdxMip) const
+{
+	const FMipUpload& MipUpload = Mips[IdxMip];
+
+	if (Result)
+	{
+		return (const uint8*)Result->getTexture().buffer + MipUpload.Offset;
+	}
+
+	return MipUpload.Data;
+}
+
+TextureUploadBatch::FTextureUpload& TextureUploadBatch::Stage(USubstanceTexture2D* Texture, uint32 MipsMask)
+{
+	check(IsInGameThread());
+
+	if (NULL == Staged)
+	{
+		Staged = new FUploads;
+	}
+
+	FTextureUpload* Upload = NULL;
+
+	for (int32 Idx = 0; Idx < Staged->Num(); ++Idx)
+	{
+		if ((*Staged)[Idx].Texture == Texture)
+		{
+			Upload = &(*Staged)[Idx];
+			break;
+		}
+	}
+
+	if (NULL == Upload)
+	{
+		Upload = new FTextureUpload;
+		Upload->Texture = Texture;
+		Staged->Add(Upload);
+	}
+
+	// mips staged before and not in the mask are still up to date
+	if (Upload->Result || Upload->Mips.Num() != Texture->Mips.Num())
+	{
+		Upload->Reset();
+		Upload->Mips.AddZeroed(Texture->Mips.Num());
+	}
+	else
+	{
+		for (int32 IdxMip = 0; IdxMip < Upload->Mips.Num(); ++IdxMip)
+		{
+			if (MipsMask & (1u << IdxMip))
+			{
+				FMipUpload& MipUpload = Upload->Mips[IdxMip];
+				MipBufferPool::Get().Free(MipUpload.Data, MipUpload.Size);
+				FMemory::Memzero(MipUpload);
+			}
+		}
+	}
+
+	return *Upload;
+}
+
+void TextureUploadBatch::Add(USubstanceTexture2D* Texture, uint32 MipsMask /*= ~0u*/)
+{
+	// placeholder textures have nothing to upload
+	if (0 == MipsMask || 0 == Texture->Mips.Num())
+	{
+		return;
+	}
+
+	FTextureUpload& Upload = Stage(Texture, MipsMask);
+
+	for (int32 IdxMip = 0; IdxMip < Texture->Mips.Num(); ++IdxMip)
+	{
+		if (0 == (MipsMask & (1u << IdxMip)))
+		{
+			continue;
+		}
+
+		FTexture2DMipMap& MipMap = Texture->Mips[IdxMip];
+		FMipUpload& MipUpload = Upload.Mips[IdxMip];
+		const int32 Size = MipMap.BulkData.GetBulkDataSize();
+
+		MipUpload.Size = Size;
+		MipUpload.SizeX = MipMap.SizeX;
+		MipUpload.SizeY = MipMap.SizeY;
+		MipUpload.Data = MipBufferPool::Get().Alloc(Size);
+
+		FMemory::Memcpy(MipUpload.Data, MipMap.BulkData.Lock(LOCK_READ_ONLY), Size);
+		MipMap.BulkData.Unlock();
+	}
+}
+
+void TextureUploadBatch::Adopt(USubstanceTexture2D* Texture, RenderResult* Result)
+{
+	FTextureUpload& Upload = Stage(Texture, ~0u);
+	Upload.Result = Result;
+
+	// mips are contiguous in the result buffer, same layout as bulk data
+	SIZE_T Offset = 0;
+
+	for (int32 IdxMip = 0; IdxMip < Texture->Mips.Num(); ++IdxMip)
+	{
+		const FTexture2DMipMap& MipMap = Texture->Mips[IdxMip];
+		FMipUpload& MipUpload = Upload.Mips[IdxMip];
+
+		MipUpload.Offset = Offset;
+		MipUpload.Size = CalculateImageBytes(MipMap.SizeX, MipMap.SizeY, 0, Texture->Format);
+		MipUpload.SizeX = MipMap.SizeX;
+		MipUpload.SizeY = MipMap.SizeY;
+
+		Offset += MipUpload.Size;
+	}
+}
+
+void TextureUploadBatch::Submit()
+{
+	check(IsInGameThread());
+
+	if (Staged)
+	{
+		// resources are resolved now: they may have been recreated since added
+		SIZE_T UploadedBytes = 0;
+
+		for (int32 Idx = Staged->Num() - 1; Idx >= 0; --Idx)
+		{
+			FTextureUpload& Upload = (*Staged)[Idx];
+			Upload.Resource = (FSubstanceTexture2DDynamicResource*)Upload.Texture->Resource;
+
+			if (NULL == Upload.Resource)
+			{
+				Staged->RemoveAt(Idx);
+				continue;
+			}
+
+			for (int32 IdxMip = 0; IdxMip < Upload.Mips.Num(); ++IdxMip)
+			{
+				UploadedBytes += Upload.Mips[IdxMip].Size;
+			}
+		}
+
+		SET_DWORD_STAT(STAT_SubstanceUploadedTextures, Staged->Num());
+		SET_MEMORY_STAT(STAT_SubstanceUploadedBytes, UploadedBytes);
+
+		if (Staged->Num() == 0)
+		{
+			delete Staged;
+			Staged = NULL;
+		}
+	}
+
+	// nothing new: resume the carried over uploads, unless a command is
+	// already in flight to do it
+	if (NULL == Staged &&
+		(0 == GPendingBatchesCount.GetValue() || !Fence.IsFenceComplete()))
+	{
+		return;
+	}
+
+	// double buffering: previous batch is usually uploaded for long
+	Wait();
+
+	const SIZE_T BudgetBytes = (SIZE_T)FMath::Max(GetDefault<USubstanceSettings>()->TextureUploadBudgetKb, 0) * 1024;
+
+	ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+		UploadSubstanceTextures,
+		TextureUploadBatch::FUploads*,Uploads,Staged,
+		SIZE_T,BudgetBytes,BudgetBytes,
+	{
+		TextureUploadBatch::Process(Uploads, BudgetBytes);
+	});
+
+	Fence.BeginFence();
+	Staged = NULL;
+}
+
+void TextureUploadBatch::Wait()
+{
+	Fence.Wait();
+}
+
+void TextureUploadBatch::Flush()
+{
+	Submit();
+
+	ENQUEUE_UNIQUE_RENDER_COMMAND(
+		FlushSubstanceTextures,
+	{
+		TextureUploadBatch::Process(NULL, 0);
+	});
+
+	Fence.BeginFence();
+	Wait();
+}
+
+void TextureUploadBatch::Cancel(FSubstanceTexture2DDynamicResource* Resource)
+{
+	check(IsInRenderingThread());
+
+	for (int32 IdxBatch = 0; IdxBatch < GPendingBatches.Num(); ++IdxBatch)
+	{
+		FUploads& Batch = *GPendingBatches[IdxBatch];
+
+		for (int32 Idx = 0; Idx < Batch.Num(); ++Idx)
+		{
+			if (Batch[Idx].Resource == Resource)
+			{
+				Batch[Idx].Resource = NULL;
+			}
+		}
+	}
+}
+
+void TextureUploadBatch::Process(FUploads* Uploads, SIZE_T BudgetBytes)
+{
+	check(IsInRenderingThread());
+	SCOPE_CYCLE_COUNTER(STAT_SubstanceUploadTextures);
+
+	if (Uploads)
+	{
+		GPendingBatches.Add(Uploads);
+		GPendingBatchesCount.Increment();
+	}
+
+	// the budget is shared by the commands of a frame
+	if (GBudgetFrame != GFrameNumberRenderThread)
+	{
+		GBudgetFrame = GFrameNumberRenderThread;
+		GBudgetUsed = 0;
+	}
+
+	while (GPendingBatches.Num() != 0)
+	{
+		FUploads& Batch = *GPendingBatches[0];
+
+		for (; GResumeUpload < Batch.Num(); ++GResumeUpload, GResumeMip = 0, GResumeRow = 0)
+		{
+			FTextureUpload& Upload = Batch[GResumeUpload];
+
+			// resource released since submitted
+			if (NULL == Upload.Resource)
+			{
+				continue;
+			}
+
+			for (; GResumeMip < Upload.Mips.Num(); ++GResumeMip, GResumeRow = 0)
+			{
+				const FMipUpload& MipUpload = Upload.Mips[GResumeMip];
+
+				// unchanged mip
+				if (0 == MipUpload.Size)
+				{
+					continue;
+				}
+
+				if (BudgetBytes != 0 && GBudgetUsed >= BudgetBytes)
+				{
+					SET_DWORD_STAT(STAT_SubstanceCarriedOverUploads, GPendingBatches.Num());
+					return;
+				}
+
+				const uint8* Data = Upload.GetMipData(GResumeMip);
+
+				if (!Upload.Resource->SupportsRegionUpdate())
+				{
+					Upload.Resource->UpdateMip(
+						GResumeMip,
+						MipUpload.SizeX,
+						MipUpload.SizeY,
+						Data,
+						MipUpload.Size);
+
+					GBudgetUsed += MipUpload.Size;
+					continue;
+				}
+
+				// rows left in the budget, one at least
+				const SIZE_T Pitch = MipUpload.Size / MipUpload.SizeY;
+				int32 NumRows = MipUpload.SizeY - GResumeRow;
+
+				if (BudgetBytes != 0)
+				{
+					NumRows = FMath::Clamp((int32)((BudgetBytes - GBudgetUsed) / Pitch), 1, NumRows);
+				}
+
+				Upload.Resource->UpdateMipRows(
+					GResumeMip,
+					MipUpload.SizeX,
+					GResumeRow,
+					NumRows,
+					Data + GResumeRow * Pitch);
+
+				GBudgetUsed += NumRows * Pitch;
+				GResumeRow += NumRows;
+
+				// the rest of the mip next frame
+				if (GResumeRow < MipUpload.SizeY)
+				{
+					SET_DWORD_STAT(STAT_SubstanceCarriedOverUploads, GPendingBatches.Num());
+					return;
+				}
+			}
+		}
+
+		// adopted engine buffers are released here
+		delete GPendingBatches[0];
+		GPendingBatches.RemoveAt(0);
+		GPendingBatchesCount.Decrement();
+
+		GResumeUpload = 0;
+		GResumeMip = 0;
+		GResumeRow = 0;
+	}
+
+	SET_DWORD_STAT(STAT_SubstanceCarriedOverUploads, 0);
+}
@@ -0,0 +1,122 @@
+//! @file SubstanceTextureUpload.h
+//! @brief Batched upload of the Substance textures mips
+//! @date 20150323
+//! @copyright Allegorithmic. All rights reserved.
+#pragma once
+
+#include "RenderCommandFence.h"
+
+class USubstanceTexture2D;
+
+namespace Substance
+{
+	struct RenderResult;
+
+	//! @brief Collects the textures updated by the game thread and uploads
+	//! their mips with a single render command. Mips are copied when added:
+	//! the render thread never reads the textures mips, the game thread can
+	//! update them again without flushing rendering commands. Render results
+	//! can also be adopted: their buffer is uploaded without any copy.
+	//! The render thread uploads TextureUploadBudgetKb per frame at most,
+	//! the rest of the submitted batches is carried over to the next frames.
+	//! Uncompressed mips are updated by regions of rows, a large mip can be
+	//! spread over several frames.
+	class TextureUploadBatch
+	{
+	public:
+		//! @brief Mip content to upload
+		struct FMipUpload
+		{
+			//! @brief Copied content (MipBufferPool), NULL if adopted
+			uint8* Data;
+
+			//! @brief Offset of the mip in the adopted result buffer
+			SIZE_T Offset;
+
+			//! @brief Size of the content, 0 if the mip is not uploaded
+			SIZE_T Size;
+			int32 SizeX;
+			int32 SizeY;
+		};
+
+		//! @brief Texture to upload, resource is resolved at submit
+		struct FTextureUpload
+		{
+			USubstanceTexture2D* Texture;
+			class FSubstanceTexture2DDynamicResource* Resource;
+			TArray<FMipUpload> Mips;
+
+			//! @brief Adopted render result, NULL if mips are copied
+			RenderResult* Result;
+
+			FTextureUpload();
+
+			//! @brief Release the adopted result (Engine::enqueueRelease)
+			//!		and give the copied mips back to the pool
+			~FTextureUpload();
+
+			//! @brief Release the content, keep the texture
+			void Reset();
+
+			//! @brief Accessor on the content of a mip
+			const uint8* GetMipData(int32 IdxMip) const;
+		};
+
+		//! @brief Uploads of a batch, owned by the render command once submitted
+		typedef TIndirectArray<FTextureUpload> FUploads;
+
+		TextureUploadBatch();
+		~TextureUploadBatch();
+
+		//! @brief Copy the current mips of a texture for upload
+		//! @param MipsMask Mask of the mips to upload, the others are unchanged
+		//! @note A texture added twice is uploaded once, w/ its last mips
+		void Add(USubstanceTexture2D* Texture, uint32 MipsMask = ~0u);
+
+		//! @brief Upload a texture from the buffer of its render result
+		//! @param Result The result the texture mips are updated from, the
+		//!		ownership is transferred. Released after upload.
+		//! @note The texture mips sizes must match the result
+		void Adopt(USubstanceTexture2D* Texture, RenderResult* Result);
+
+		//! @brief Upload the added textures w/ one render command
+		//! Waits for the previously submitted batch first: at most one batch
+		//! is uploading while the next one is collected. Also resumes the
+		//! uploads carried over if the render thread is idle.
+		void Submit();
+
+		//! @brief Wait for the submitted batch to be processed by the render
+		//!		thread, carried over uploads may remain
+		void Wait();
+
+		//! @brief Submit and upload all the pending uploads, w/o budget
+		void Flush();
+
+		//! @brief Drop the pending uploads of a resource being released
+		//! @note Called by the render thread
+		static void Cancel(class FSubstanceTexture2DDynamicResource* Resource);
+
+		//! @brief Upload a new batch after the carried over ones
+		//! @param Uploads The new batch, can be NULL, owned once called
+		//! @param BudgetBytes Bytes to upload per frame, 0 for no limit
+		//! @note Called by the render thread
+		static void Process(FUploads* Uploads, SIZE_T BudgetBytes);
+
+		//! @brief Count of textures added since last submit
+		int32 Num() const { return Staged ? Staged->Num() : 0; }
+
+	private:
+		//! @brief Textures added since last submit, NULL if none
+		FUploads* Staged;
+
+		//! @brief Fence of the last submitted batch
+		FRenderCommandFence Fence;
+
+		//! @brief Find or add the upload of a texture, reset its content
+		//! @param MipsMask Mask of the mips to reset, the others are kept
+		FTextureUpload& Stage(USubstanceTexture2D* Texture, uint32 MipsMask);
+
+		TextureUploadBatch(const TextureUploadBatch&);
+		TextureUploadBatch& operator=(const TextureUploadBatch&);
+	};
+}
@@ -16,6 +16,7 @@
 #include "framework/details/detailslinkgraphs.h"
 #include "framework/details/detailslinkcontext.h"
 #include "framework/details/detailslinkdata.h"
+#include "framework/details/detailslinkcache.h"
 #include "framework/details/detailsrendererimpl.h"
 #include "framework/renderresult.h"
 #include "framework/renderopt.h"
@@ -25,6 +26,7 @@
 #include "SubstanceSettings.h"
 
 #include "ThreadingBase.h"
+#include "SecureHash.h"
 
 #include <algorithm>
 #include <iterator>
@@ -209,11 +211,14 @@ uint32 Substance::Details::Engine::mLastInstanceUid = uint32();
 Substance::Details::Engine::Engine(const RenderOptions& renderOptions) :
 	mInstanceUid((++mLastInstanceUid)|0x80000000u),
 	mLinkerCacheData(NULL),
+	mLinkerSynced(true),
 	mHandle(NULL),
 	mLinkerContext(NULL),
 	mLinkerHandle(NULL),
 	mCurrentLinkContext(NULL),
-	mPendingReleaseTextures(false)
+	mPendingReleaseTextures(false),
+	mLinkCacheEnabled(renderOptions.mLinkCache),
+	mLinkCacheMaxSize(renderOptions.mLinkCacheMaxSize)
 {
 	fillHardResources(mHardResources,renderOptions);
 	createLinker();
@@ -273,6 +278,9 @@ void Substance::Details::Engine::releaseEngine()
 		check(res==0);
 	}
 
+	// No more SBSBIN, next link is full
+	mLinkedStateUids.clear();
+
 	// Release pending textures
 	releaseTextures();
 
@@ -298,62 +306,167 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 		linkgraphs.merge(renderJobBegin->getLinkGraphs());
 	}
 
-	TArray<unsigned int> enabledIds;
+	// Build push order: states of previous link first, in previous order
+	// (linker is deterministic: same translated UIDs, maximal cache 
+	// transfer), then new states.
+	LinkGraphs pushedgraphs;
+	pushedgraphs.graphStates.reserve(linkgraphs.graphStates.size());
+	SBS_VECTOR_FOREACH (uint32 stateUid,mLinkedStateUids)
+	{
+		const LinkGraphs::GraphStatePtr* graphstateptr = 
+			linkgraphs.find(stateUid);
+		if (graphstateptr!=NULL)
+		{
+			pushedgraphs.graphStates.push_back(*graphstateptr);
+		}
+	}
 
-	// Push all states to link
+	const size_t prevcount = pushedgraphs.graphStates.size();
+	std::vector<uint32> prevuids(mLinkedStateUids);
+	std::sort(prevuids.begin(),prevuids.end());
 	SBS_VECTOR_FOREACH (
 		const LinkGraphs::GraphStatePtr& graphstateptr,
 		linkgraphs.graphStates)
 	{
-		LinkContext linkContext(
-			mLinkerHandle,
-			graphstateptr->getBinary(),
-			graphstateptr->getUid());
-		linkContext.graphBinary.resetTranslatedUids();  // Reset translated UID
-		mCurrentLinkContext = &linkContext;  // Set as current context to fill
-		graphstateptr->getLinkData()->push(linkContext);
-
-		// Select outputs
-		SBS_VECTOR_FOREACH (
-			const GraphBinary::Entry& entry,
-			linkContext.graphBinary.outputs)
-		{		
-			enabledIds.Push(entry.uidTranslated);
+		if (!std::binary_search(
+			prevuids.begin(),
+			prevuids.end(),
+			graphstateptr->getUid()))
+		{
+			pushedgraphs.graphStates.push_back(graphstateptr);
 		}
 	}
 
-	res = SubstanceLinkerEnableOutputs(
-		mLinkerHandle,
-		enabledIds.GetData(),
-		enabledIds.Num());
+	if (mHandle!=NULL && 
+		pushedgraphs.graphStates.size()==prevcount &&
+		prevcount==mLinkedStateUids.size())
+	{
+		// No new nor removed state: current SBSBIN already contains all 
+		// states, skip link. Removed states are simply no more computed 
+		// until next link, except if link is forced (states released).
+		return true;
+	}
 
-	if (res)
+	if (pushedgraphs.graphStates.empty())
 	{
-		assert(0);
+		// All states released: nothing left to link, drop current SBSBIN
+		Sync::unique_lock slock(mMutexHandle);
+
+		if (mHandle!=NULL)
+		{
+			res = SubstanceHandleRelease(mHandle);
+			mHandle = NULL;
+			check(res==0);
+		}
+
+		mSbsbinDatas[0].resize(0);
+		mSbsbinDatas[1].resize(0);
+		mLinkedStateUids.resize(0);
+		mLinkerSynced = false;
+		return true;
 	}
-		
-	// Link, Grab assembly
+
+	// Select SBSBIN data buffer
 	size_t sbsbindataindex = mSbsbinDatas[0].empty() ? 0 : 1;
 	std::string &sbsbindata = mSbsbinDatas[sbsbindataindex];
 	check(mSbsbinDatas[0].empty()||mSbsbinDatas[1].empty());
+
+	// Try linked SBSBIN disk cache first, cold link or new states admitted
+	const bool uselinkcache = mLinkCacheEnabled;
+	LinkCache::Key linkcachekey;
+	std::vector<uint32> translateduids;
+	bool linkcachehit = false;
+	if (uselinkcache)
 	{
-		const unsigned char* resultData = NULL;
-		size_t resultSize = 0;
-		res = SubstanceLinkerLink(
+		computeLinkCacheKey(linkcachekey,pushedgraphs);
+		translateduids.resize(getEntriesCount(pushedgraphs));
+		linkcachehit = LinkCache::read(linkcachekey,sbsbindata,translateduids);
+		if (linkcachehit)
+		{
+			scatterTranslatedUids(pushedgraphs,translateduids);
+		}
+	}
+
+	if (!linkcachehit)
+	{
+		TArray<unsigned int> enabledIds;
+
+		// Push all states to link
+		SBS_VECTOR_FOREACH (
+			const LinkGraphs::GraphStatePtr& graphstateptr,
+			pushedgraphs.graphStates)
+		{
+			LinkContext linkContext(
+				mLinkerHandle,
+				graphstateptr->getBinary(),
+				graphstateptr->getUid());
+			linkContext.graphBinary.resetTranslatedUids();  // Reset translated UID
+			mCurrentLinkContext = &linkContext;  // Set as current context to fill
+			graphstateptr->getLinkData()->push(linkContext);
+
+			// Select outputs
+			SBS_VECTOR_FOREACH (
+				const GraphBinary::Entry& entry,
+				linkContext.graphBinary.outputs)
+			{		
+				enabledIds.Push(entry.uidTranslated);
+			}
+		}
+		
+		mCurrentLinkContext = NULL;
+
+		res = SubstanceLinkerEnableOutputs(
+			mLinkerHandle,
+			enabledIds.GetData(),
+			enabledIds.Num());
+
+		if (res)
+		{
+			assert(0);
+		}
+			
+		// Link, Grab assembly
+		{
+			const unsigned char* resultData = NULL;
+			size_t resultSize = 0;
+			res = SubstanceLinkerLink(
+				mLinkerHandle,
+				&resultData,
+				&resultSize);
+			check(res==0);
+		
+			sbsbindata.assign((const char*)resultData,resultSize);
+		}
+
+		// Grab new cache data blob
+		res = SubstanceLinkerGetCacheMapping(
 			mLinkerHandle,
-			&resultData,
-			&resultSize);
+			&mLinkerCacheData,
+			mLinkerCacheData);
 		check(res==0);
-	
-		sbsbindata.assign((const char*)resultData,resultSize);
+
+		// Store for next link of the same states
+		if (uselinkcache)
+		{
+			gatherTranslatedUids(pushedgraphs,translateduids);
+			LinkCache::write(
+				linkcachekey,
+				sbsbindata,
+				translateduids,
+				mLinkCacheMaxSize);
+		}
+	}
+	else
+	{
+		// The linker never saw these states: no cache mapping from them
+		mLinkerCacheData = NULL;
 	}
 
-	// Grab new cache data blob
-	res = SubstanceLinkerGetCacheMapping(
-		mLinkerHandle,
-		&mLinkerCacheData,
-		mLinkerCacheData);
-	check(res==0);
+	// The handle cache is transferred only if the linker produced both the
+	// previous and the new SBSBIN: the first link following a link cache 
+	// hit, and a warm link hit, drop the engine cache of the previous handle
+	const bool transfercache = mLinkerSynced && !linkcachehit;
+	mLinkerSynced = !linkcachehit;
 	
 	// Create Substance context if necessary, done on render thread(required
 	//	by some impl.) 
@@ -380,11 +493,14 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 		if (mHandle!=NULL)
 		{
 			// Transfer
-			res = SubstanceHandleTransferCache(
-				newhandle,
-				mHandle,
-				mLinkerCacheData);
-			check(res==0);
+			if (transfercache)
+			{
+				res = SubstanceHandleTransferCache(
+					newhandle,
+					mHandle,
+					mLinkerCacheData);
+				check(res==0);
+			}
 	
 			// Delete previous handle
 			res = SubstanceHandleRelease(mHandle);
@@ -399,7 +515,16 @@ bool Substance::Details::Engine::link(RenderJob* renderJobBegin)
 	}
 	
 	// Fill Graph binary SBSBIN indices
-	fillIndices(linkgraphs);
+	fillIndices(pushedgraphs);
+
+	// Record new composition
+	mLinkedStateUids.resize(0);
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		pushedgraphs.graphStates)
+	{
+		mLinkedStateUids.push_back(graphstateptr->getUid());
+	}
 	
 	return true;
 }
@@ -432,17 +557,22 @@ void Substance::Details::Engine::stop()
 
 //! @brief Set new memory budget and CPU usage.
 //! @param renderOptions New render options to use.
+//! @param coresLimit Maximum cores count of this engine, already split
+//!		between the workers, 0 if no limit.
 //! @note This function can be called at any time, from any thread.
 //!	@return Return true if options are immediately processed.
 bool Substance::Details::Engine::setOptions(
-	const RenderOptions& renderOptions)
+	const RenderOptions& renderOptions,
+	size_t coresLimit)
 {
 	unsigned int res, state = 0;
 	(void)res;
 	
 	Sync::unique_lock slock(mMutexHandle);
 	
-	fillHardResources(mHardResources,renderOptions);
+	fillHardResources(mHardResources,renderOptions,coresLimit);
+	mLinkCacheEnabled = renderOptions.mLinkCache;
+	mLinkCacheMaxSize = renderOptions.mLinkCacheMaxSize;
 	
 	if (mHandle!=NULL)
 	{
@@ -494,20 +624,64 @@ void Substance::Details::Engine::clearCache()
 }
 
 
+//! @brief Release engine intermediate caches and pending textures
+//! @param targetBytes Memory budget to shrink the engine caches to, 0 to
+//!		release all of them.
+//! @pre No render currently running
+//! @note Called from render thread, between render jobs
+void Substance::Details::Engine::trim(size_t targetBytes)
+{
+	// Result textures not yet released
+	releaseTextures();
+
+	Sync::unique_lock slock(mMutexHandle);
+	
+	if (mHandle != NULL)
+	{
+		// Cold run w/ reduced budget: engine evicts its cache down to it
+		SubstanceHardResources trimRsc = mHardResources;
+		trimRsc.systemMemoryBudget = trimRsc.videoMemoryBudget[0] = 
+			targetBytes!=0 ?
+				std::min<size_t>(targetBytes,mHardResources.systemMemoryBudget) :
+				SUBSTANCE_MEMORYBUDGET_FORCEFLUSH;
+
+		SubstanceHandleSwitchHard(mHandle, Substance_Sync_Synchronous, &trimRsc);
+		SubstanceHandleStart(mHandle);
+
+		// Then restore budget, linker and handle are kept alive
+		SubstanceHandleSwitchHard(mHandle, Substance_Sync_Synchronous, &mHardResources);
+		SubstanceHandleStart(mHandle);
+	}
+}
+
+
+//! @brief Fill hard resources from render options
+//! @param coresLimit Maximum cores count of this engine, 0 if no limit
 void Substance::Details::Engine::fillHardResources(
 	SubstanceHardResources& hardRsc,
-	const RenderOptions& renderOptions)
+	const RenderOptions& renderOptions,
+	size_t coresLimit)
 {
 	memset(&hardRsc, 0, sizeof(SubstanceHardResources));
 
+	// Budget and cores are shared between the renderer pool workers.
+	// The limit is split by the pool (sum of workers limits stays below
+	// it): applied after the share, never rounded up.
+	const size_t workersCount = std::max<size_t>(renderOptions.mWorkersCount, 1);
+	size_t coresCount = std::max<size_t>(renderOptions.mCoresCount / workersCount, 1);
+	if (coresLimit!=0)
+	{
+		coresCount = std::min(coresCount, coresLimit);
+	}
+
 	// 16kb minimum
 	hardRsc.systemMemoryBudget = hardRsc.videoMemoryBudget[0] =
-		renderOptions.mMemoryBudget | 0x4000;
+		(renderOptions.mMemoryBudget / workersCount) | 0x4000;
 
 	// Switch on/off CPU usage
 	for (size_t k = 0; k < SUBSTANCE_CPU_COUNT_MAX; ++k)
 	{
-		hardRsc.cpusUse[k] = k < std::max<size_t>(renderOptions.mCoresCount, 1) ?
+		hardRsc.cpusUse[k] = k < coresCount ?
 			Substance_Resource_FullUse :
 			Substance_Resource_DoNotUse;
 	}
@@ -607,66 +781,169 @@ void Substance::Details::Engine::fillIndices(LinkGraphs& linkGraphs) const
 			troutputs.push_back(std::make_pair(outdesc.outputId, dindex));
 		}
 	}
-	typedef std::vector<std::pair<uint32,GraphBinary::Entry*> > UidEntryPairs;
-	UidEntryPairs einputs,eoutputs;
+	// Sort handle I/O per translated UID
+	std::sort(trinputs.begin(),trinputs.end());
+	std::sort(troutputs.begin(),troutputs.end());
 
-	// Get graph binaries entries per translated uids
+	// Fill graph binaries entries w/ indices, searched per translated UID
 	SBS_VECTOR_FOREACH (
 		const LinkGraphs::GraphStatePtr& graphstateptr,
 		linkGraphs.graphStates)
 	{
 		GraphBinary& binary = graphstateptr->getBinary();
 		
-		// Get all input entries
+		// Fill input entries (unused inputs are skipped, multi-graph case)
 		SBS_VECTOR_FOREACH (GraphBinary::Entry& entry,binary.inputs)
 		{
-			einputs.push_back(std::make_pair(entry.uidTranslated,&entry));
+			UidIndexPairs::const_iterator trite = std::lower_bound(
+				trinputs.begin(),
+				trinputs.end(),
+				UidIndexPairs::value_type(entry.uidTranslated,0));
+			check(trite!=trinputs.end() && trite->first==entry.uidTranslated);
+			if (trite!=trinputs.end() && trite->first==entry.uidTranslated)
+			{
+				entry.index = trite->second;
+			}
 		}
 		
-		// Get all output entries
+		// Fill output entries
 		SBS_VECTOR_FOREACH (GraphBinary::Entry& entry,binary.outputs)
 		{
-			eoutputs.push_back(std::make_pair(entry.uidTranslated,&entry));
+			UidIndexPairs::const_iterator trite = std::lower_bound(
+				troutputs.begin(),
+				troutputs.end(),
+				UidIndexPairs::value_type(entry.uidTranslated,0));
+			check(trite!=troutputs.end() && trite->first==entry.uidTranslated);
+			if (trite!=troutputs.end() && trite->first==entry.uidTranslated)
+			{
+				entry.index = trite->second;
+			}
 		}
 		
 		// Mark as linked
 		binary.linked();
 	}
-	
-	// Sort all, per translated UID
-	std::sort(trinputs.begin(),trinputs.end());
-	std::sort(troutputs.begin(),troutputs.end());
-	std::sort(einputs.begin(),einputs.end());
-	std::sort(eoutputs.begin(),eoutputs.end());
-	
-	// Fill input entries w/ indices
-	UidIndexPairs::const_iterator trite = trinputs.begin();
-	SBS_VECTOR_FOREACH (UidEntryPairs::value_type& epair,einputs)
+}
+
+
+//! @brief Compute the linked SBSBIN disk cache key of states to link
+//! @param key Receive the key
+//! @param linkGraphs Graph states, in push order
+void Substance::Details::Engine::computeLinkCacheKey(
+	LinkCache::Key& key,
+	const LinkGraphs& linkGraphs)
+{
+	FSHA1 hashstate;
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
 	{
-		// Skip unused inputs (multi-graph case)
-		while (trite!=trinputs.end() && trite->first<epair.first)
+		// State UIDs are not hashed: process-wide counter, they depend on 
+		// load order. Translated UIDs only depend on the push order and on
+		// the I/O below.
+
+		// Assembly, output formats, stacking options
+		graphstateptr->getLinkData()->hash(hashstate);
+
+		// I/O to translate
+		const GraphBinary& binary = graphstateptr->getBinary();
+		const uint32 counts[2] = {
+			(uint32)binary.inputs.size(),
+			(uint32)binary.outputs.size() };
+		hashstate.Update((const uint8*)counts,sizeof(counts));
+		
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& entry,binary.inputs)
 		{
-			++trite;
-		}	
-		check(trite!=trinputs.end() && trite->first==epair.first);
-		if (trite!=trinputs.end() && trite->first==epair.first)
+			hashstate.Update(
+				(const uint8*)&entry.uidInitial,
+				sizeof(entry.uidInitial));
+		}
+		
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& entry,binary.outputs)
 		{
-			epair.second->index = (trite++)->second;
+			hashstate.Update(
+				(const uint8*)&entry.uidInitial,
+				sizeof(entry.uidInitial));
 		}
 	}
-	
-	// Fill output entries w/ indices
-	trite = troutputs.begin();
-	SBS_VECTOR_FOREACH (UidEntryPairs::value_type& epair,eoutputs)
+
+	hashstate.Final();
+	hashstate.GetHash(key.digest);
+}
+
+
+//! @brief Return the count of I/O entries of graph states binaries
+size_t Substance::Details::Engine::getEntriesCount(
+	const LinkGraphs& linkGraphs)
+{
+	size_t count = 0;
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
 	{
-		check(trite!=troutputs.end() && trite->first==epair.first);
-		while (trite!=troutputs.end() && trite->first<epair.first)
+		const GraphBinary& binary = graphstateptr->getBinary();
+		count += binary.inputs.size()+binary.outputs.size();
+	}
+
+	return count;
+}
+
+
+//! @brief Copy translated UIDs of graph states binaries into an array
+//! @param linkGraphs Graph states, in push order
+//! @param translatedUids Receive translated UIDs (inputs then outputs of 
+//!		each state)
+void Substance::Details::Engine::gatherTranslatedUids(
+	const LinkGraphs& linkGraphs,
+	std::vector<uint32>& translatedUids)
+{
+	translatedUids.resize(0);
+	translatedUids.reserve(getEntriesCount(linkGraphs));
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		const GraphBinary& binary = graphstateptr->getBinary();
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& entry,binary.inputs)
+		{
+			translatedUids.push_back(entry.uidTranslated);
+		}
+		
+		SBS_VECTOR_FOREACH (const GraphBinary::Entry& entry,binary.outputs)
 		{
-			++trite;
-		}	
-		if (trite!=troutputs.end() && trite->first==epair.first)
+			translatedUids.push_back(entry.uidTranslated);
+		}
+	}
+}
+
+
+//! @brief Copy translated UIDs from an array into graph states binaries
+//! @param linkGraphs Graph states, in push order
+//! @param translatedUids Translated UIDs (gatherTranslatedUids() layout)
+void Substance::Details::Engine::scatterTranslatedUids(
+	const LinkGraphs& linkGraphs,
+	const std::vector<uint32>& translatedUids)
+{
+	check(translatedUids.size()==getEntriesCount(linkGraphs));
+	std::vector<uint32>::const_iterator trite = translatedUids.begin();
+
+	SBS_VECTOR_FOREACH (
+		const LinkGraphs::GraphStatePtr& graphstateptr,
+		linkGraphs.graphStates)
+	{
+		GraphBinary& binary = graphstateptr->getBinary();
+		binary.resetTranslatedUids();
+
+		SBS_VECTOR_FOREACH (GraphBinary::Entry& entry,binary.inputs)
+		{
+			entry.uidTranslated = *(trite++);
+		}
+		
+		SBS_VECTOR_FOREACH (GraphBinary::Entry& entry,binary.outputs)
 		{
-			epair.second->index = (trite++)->second;
+			entry.uidTranslated = *(trite++);
 		}
 	}
 }
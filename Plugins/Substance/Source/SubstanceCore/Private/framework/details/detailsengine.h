@@ -9,7 +9,9 @@
 #define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSENGINE_H
 
 #include <string>
+#include <vector>
 #include "detailsgraphbinary.h"
+#include "detailslinkcache.h"
 #include "detailssync.h"
 #include "SubstanceCallbacks.h"
 
@@ -50,6 +52,10 @@ public:
 	//! @brief Link/Relink all states in pending render jobs
 	//! @param renderJobBegin Begin of chained list of render jobs to link
 	//! @return Return true if link process succeed
+	//!
+	//! Incremental: states already present in current SBSBIN keep their
+	//! push order (and therefore their translated UIDs), new states are
+	//! appended. If no new state, linker is skipped and current handle kept.
 	bool link(RenderJob* renderJobBegin);
 	
 	//! @brief Flush internal engine queue
@@ -63,12 +69,24 @@ public:
 
 	//! @brief Set new memory budget and CPU usage.
 	//! @param renderOptions New render options to use.
+	//! @param coresLimit Maximum cores count of this engine, already split
+	//!		between the workers, 0 if no limit.
 	//! @note This function can be called at any time, from any thread.
 	//!	@return Return true if options are immediately processed.
-	bool setOptions(const RenderOptions& renderOptions);
+	bool setOptions(const RenderOptions& renderOptions, size_t coresLimit = 0);
 
 	//! @brief 
 	void clearCache();
+
+	//! @brief Release engine intermediate caches and pending textures
+	//! @param targetBytes Memory budget to shrink the engine caches to, 0 to
+	//!		release all of them.
+	//! @pre No render currently running
+	//! @note Called from render thread, between render jobs
+	//!
+	//! Linker, handle and SBSBIN are kept: next render does not pay any
+	//! relink/handle creation, only recomputes evicted intermediate results.
+	void trim(size_t targetBytes);
 	
 	//! @brief Linker Collision UID callback implementation
 	//! @param collisionType Output or input collision flag
@@ -139,6 +157,11 @@ protected:
 	
 	//! @brief Linker cache data generated by linker
 	const unsigned char* mLinkerCacheData;
+
+	//! @brief The current SBSBIN was produced by the linker
+	//! False if read from the link cache: the linker did not see its
+	//! states, the next link cannot map (transfer) the handle cache.
+	bool mLinkerSynced;
 	
 	//! @brief The current substance handle
 	//! NULL if not yet linked
@@ -161,6 +184,9 @@ protected:
 	//! @brief Contains current filled binary, used during link (by callbacks)
 	LinkContext *mCurrentLinkContext;
 
+	//! @brief UIDs of the graph states present in current SBSBIN data
+	//! In linker push order, used for incremental link.
+	std::vector<uint32> mLinkedStateUids;
 	//! @brief List of textures to delete
 	//! R/W access thread safety ensure by mMutexToRelease.
 	TexturesList mToReleaseTextures;
@@ -171,11 +197,42 @@ protected:
 	//! @brief Pending textures to release into mToReleaseTextures
 	//! Can be set from any thread. Unset from render thread.
 	volatile bool mPendingReleaseTextures;
+
+	//! @brief Use linked SBSBIN disk cache
+	bool mLinkCacheEnabled;
+
+	//! @brief Maximum size of the linked SBSBIN disk cache, 0 for no limit
+	size_t mLinkCacheMaxSize;
 	
 	//! @brief Fill Graph binaries w/ new Engine handle SBSBIN indices
 	//! @param linkGraphs Contains Graph binaries to fill indices
 	void fillIndices(LinkGraphs& linkGraphs) const;
 
+	//! @brief Compute the linked SBSBIN disk cache key of states to link
+	//! @param key Receive the key
+	//! @param linkGraphs Graph states, in push order
+	static void computeLinkCacheKey(
+		LinkCache::Key& key,
+		const LinkGraphs& linkGraphs);
+
+	//! @brief Return the count of I/O entries of graph states binaries
+	static size_t getEntriesCount(const LinkGraphs& linkGraphs);
+
+	//! @brief Copy translated UIDs of graph states binaries into an array
+	//! @param linkGraphs Graph states, in push order
+	//! @param translatedUids Receive translated UIDs (inputs then outputs of 
+	//!		each state)
+	static void gatherTranslatedUids(
+		const LinkGraphs& linkGraphs,
+		std::vector<uint32>& translatedUids);
+
+	//! @brief Copy translated UIDs from an array into graph states binaries
+	//! @param linkGraphs Graph states, in push order
+	//! @param translatedUids Translated UIDs (gatherTranslatedUids() layout)
+	static void scatterTranslatedUids(
+		const LinkGraphs& linkGraphs,
+		const std::vector<uint32>& translatedUids);
+
 	//! @brief Create Linker handle and context
 	void createLinker();
 
@@ -183,9 +240,11 @@ protected:
 	void releaseLinker();
 	
 	//! @brief Fill hard resources from render options
+	//! @param coresLimit Maximum cores count of this engine, 0 if no limit
 	static void fillHardResources(
 		SubstanceHardResources& hardRsc,
-		const RenderOptions& renderOptions);
+		const RenderOptions& renderOptions,
+		size_t coresLimit = 0);
 	
 private:
 	Engine(const Engine&);
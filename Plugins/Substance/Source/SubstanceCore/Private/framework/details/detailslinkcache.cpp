@@ -0,0 +1,230 @@
+//! @file detailslinkcache.cpp
+//! @brief Substance Framework linked SBSBIN disk cache implementation
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150318
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+
+#include "framework/details/detailslinkcache.h"
+#include "framework/details/detailssync.h"
+
+#include "Paths.h"
+
+#define SUBSTANCE_LINKCACHE_VERSION 1
+
+DEFINE_LOG_CATEGORY_STATIC(LogSubstanceLinkCache, Log, All);
+
+namespace
+{
+
+//! @brief Serializes reads, writes and evictions (one linker per engine 
+//! worker)
+Substance::Details::Sync::mutex gLinkCacheMutex;
+
+//! @brief Entry file, used for eviction
+struct EntryFile
+{
+	FString path;
+	int64 size;
+	FDateTime time;
+};
+
+//! @brief Least recently used first
+struct EntryFileOlder
+{
+	bool operator()(const EntryFile& a,const EntryFile& b) const
+	{
+		return a.time<b.time;
+	}
+};
+
+} // namespace
+
+
+//! @brief Read a cache entry
+//! @param key Key of the entry to read
+//! @param sbsbinData Receive linked SBSBIN data
+//! @param translatedUids Receive I/O translated UIDs, in push order. Must
+//!		be already sized to the I/O count: entries of different size are
+//!		rejected.
+//! @return Return true if entry found and valid
+bool Substance::Details::LinkCache::read(
+	const Key& key,
+	std::string& sbsbinData,
+	std::vector<uint32>& translatedUids)
+{
+	// Not rewritten nor evicted by an other worker while read
+	Sync::unique_lock slock(gLinkCacheMutex);
+
+	const FString path = getPath(key);
+	FArchive* Ar = IFileManager::Get().CreateFileReader(*path,FILEREAD_Silent);
+	if (Ar==NULL)
+	{
+		// Not written yet or evicted: miss
+		return false;
+	}
+
+	uint32 version = 0;
+	uint32 uidsCount = 0;
+	uint32 dataSize = 0;
+	*Ar << version;
+	*Ar << uidsCount;
+	*Ar << dataSize;
+
+	const bool valid = !Ar->IsError() &&
+		version==SUBSTANCE_LINKCACHE_VERSION &&
+		translatedUids.size()==uidsCount &&
+		Ar->TotalSize()==Ar->Tell()+uidsCount*sizeof(uint32)+dataSize;
+
+	if (valid)
+	{
+		if (uidsCount>0)
+		{
+			Ar->Serialize(&translatedUids[0],uidsCount*sizeof(uint32));
+		}
+
+		sbsbinData.resize(dataSize);
+		if (dataSize>0)
+		{
+			Ar->Serialize(&sbsbinData[0],dataSize);
+		}
+	}
+	else
+	{
+		UE_LOG(LogSubstanceLinkCache, Warning, TEXT("Invalid Substance link cache entry %s, will relink"), *path);
+	}
+
+	const bool succeed = valid && !Ar->IsError();
+	delete Ar;
+
+	if (succeed)
+	{
+		// Recently used, evicted last
+		IFileManager::Get().SetTimeStamp(*path,FDateTime::UtcNow());
+	}
+
+	return succeed;
+}
+
+
+//! @brief Write a cache entry
+//! @param key Key of the entry to write
+//! @param sbsbinData Linked SBSBIN data
+//! @param translatedUids I/O translated UIDs, in push order
+//! @param maxSize Maximum size of all entries in bytes, 0 for no limit
+void Substance::Details::LinkCache::write(
+	const Key& key,
+	const std::string& sbsbinData,
+	const std::vector<uint32>& translatedUids,
+	size_t maxSize)
+{
+	Sync::unique_lock slock(gLinkCacheMutex);
+
+	const FString path = getPath(key);
+	FArchive* Ar = IFileManager::Get().CreateFileWriter(*path,FILEWRITE_Silent);
+	if (Ar==NULL)
+	{
+		return;
+	}
+
+	uint32 version = SUBSTANCE_LINKCACHE_VERSION;
+	uint32 uidsCount = translatedUids.size();
+	uint32 dataSize = sbsbinData.size();
+	*Ar << version;
+	*Ar << uidsCount;
+	*Ar << dataSize;
+
+	if (uidsCount>0)
+	{
+		Ar->Serialize(
+			const_cast<uint32*>(&translatedUids[0]),
+			uidsCount*sizeof(uint32));
+	}
+
+	if (dataSize>0)
+	{
+		Ar->Serialize(const_cast<char*>(sbsbinData.data()),dataSize);
+	}
+
+	const bool failed = Ar->IsError();
+	delete Ar;
+
+	if (failed)
+	{
+		// Do not keep partial entry
+		IFileManager::Get().Delete(*path,false,false,true);
+		return;
+	}
+
+	trim(maxSize);
+}
+
+
+//! @brief Return the directory of the entries
+FString Substance::Details::LinkCache::getDirectory()
+{
+	return FPaths::GameSavedDir() / TEXT("Substance/Link");
+}
+
+
+//! @brief Return the file path of an entry
+FString Substance::Details::LinkCache::getPath(const Key& key)
+{
+	return FString::Printf(
+		TEXT("%s/%s.sbsbin"),
+		*getDirectory(),
+		*BytesToHex(key.digest,sizeof(key.digest)));
+}
+
+
+//! @brief Evict the least recently used entries above a size
+//! @param maxSize Maximum size of all entries in bytes, 0 for no limit
+void Substance::Details::LinkCache::trim(size_t maxSize)
+{
+	if (maxSize==0)
+	{
+		return;
+	}
+
+	IFileManager& fileManager = IFileManager::Get();
+	const FString directory = getDirectory();
+
+	TArray<FString> filenames;
+	fileManager.FindFiles(filenames,*(directory/TEXT("*.sbsbin")),true,false);
+
+	TArray<EntryFile> entries;
+	entries.Reserve(filenames.Num());
+	int64 totalSize = 0;
+
+	for (int32 k=0;k<filenames.Num();++k)
+	{
+		EntryFile entry;
+		entry.path = directory/filenames[k];
+		entry.size = fileManager.FileSize(*entry.path);
+		entry.time = fileManager.GetTimeStamp(*entry.path);
+
+		if (entry.size>0)
+		{
+			totalSize += entry.size;
+			entries.Add(entry);
+		}
+	}
+
+	if (totalSize<=(int64)maxSize)
+	{
+		return;
+	}
+
+	entries.Sort(EntryFileOlder());
+
+	for (int32 k=0;k<entries.Num() && totalSize>(int64)maxSize;++k)
+	{
+		if (fileManager.Delete(*entries[k].path,false,false,true))
+		{
+			totalSize -= entries[k].size;
+		}
+	}
+
+	UE_LOG(LogSubstanceLinkCache, Log, TEXT("Substance link cache trimmed to %d KB"), (int32)(totalSize/1024));
+}
@@ -0,0 +1,80 @@
+//! @file detailslinkcache.h
+//! @brief Substance Framework linked SBSBIN disk cache definition
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150318
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
+#define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
+
+#include "SubstanceCoreTypedefs.h"
+
+#include <string>
+#include <vector>
+
+namespace Substance
+{
+namespace Details
+{
+
+//! @brief Persistent cache of linked SBSBIN data
+//! Entries are keyed by a SHA1 of all the data pushed to the linker, in
+//! push order (assemblies, output formats, stacking options and I/O UIDs
+//! to translate). Graph states UIDs are not part of the key: process-wide
+//! counter, they depend on the load order. An entry contains the SBSBIN
+//! data and the translated UIDs of all I/O, in push order. Allows to skip SubstanceLinkerLink at cold start and when
+//! already seen states are admitted.
+//! The cache is bounded: once above its maximum size, the least recently
+//! used entries (file time, refreshed by reads) are evicted on write.
+//! Reads, writes and evictions are serialized (one linker per engine 
+//! worker): an entry evicted meanwhile is simply a miss.
+class LinkCache
+{
+public:
+	//! @brief Key of a cache entry (SHA1 digest)
+	struct Key
+	{
+		uint8 digest[20];
+	};
+
+	//! @brief Read a cache entry
+	//! @param key Key of the entry to read
+	//! @param sbsbinData Receive linked SBSBIN data
+	//! @param translatedUids Receive I/O translated UIDs, in push order. Must
+	//!		be already sized to the I/O count: entries of different size are
+	//!		rejected.
+	//! @return Return true if entry found and valid
+	static bool read(
+		const Key& key,
+		std::string& sbsbinData,
+		std::vector<uint32>& translatedUids);
+
+	//! @brief Write a cache entry
+	//! @param key Key of the entry to write
+	//! @param sbsbinData Linked SBSBIN data
+	//! @param translatedUids I/O translated UIDs, in push order
+	//! @param maxSize Maximum size of all entries in bytes, 0 for no limit
+	static void write(
+		const Key& key,
+		const std::string& sbsbinData,
+		const std::vector<uint32>& translatedUids,
+		size_t maxSize);
+
+protected:
+	//! @brief Return the directory of the entries
+	static FString getDirectory();
+
+	//! @brief Return the file path of an entry
+	static FString getPath(const Key& key);
+
+	//! @brief Evict the least recently used entries above a size
+	//! @param maxSize Maximum size of all entries in bytes, 0 for no limit
+	static void trim(size_t maxSize);
+
+};  // class LinkCache
+
+
+} // namespace Details
+} // namespace Substance
+
+#endif // ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSLINKCACHE_H
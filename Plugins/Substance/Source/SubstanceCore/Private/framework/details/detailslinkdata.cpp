@@ -13,6 +13,8 @@
 #include "framework/details/detailslinkcontext.h"
 #include "framework/details/detailsgraphbinary.h"
 
+#include "SecureHash.h"
+
 
 //! @brief Destructor
 Substance::Details::LinkData::~LinkData()
@@ -28,6 +30,7 @@ Substance::Details::LinkDataAssembly::LinkDataAssembly(
 		uint32 size) :
 	mAssembly((const char*)ptr,size)
 {
+	updateAssemblyHash();
 }
 
 
@@ -73,6 +76,31 @@ bool Substance::Details::LinkDataAssembly::push(LinkContext& cxt) const
 }
 	
 	
+//! @brief Accumulate a stable hash of the data pushed to link
+//! @param hashState SHA1 state to update
+void Substance::Details::LinkDataAssembly::hash(FSHA1& hashState) const
+{
+	hashState.Update(mAssemblyHash,sizeof(mAssemblyHash));
+
+	SBS_VECTOR_FOREACH (const OutputFormat& outfmt, mOutputFormats)
+	{
+		hashState.Update((const uint8*)&outfmt.uid,sizeof(outfmt.uid));
+		hashState.Update((const uint8*)&outfmt.format,sizeof(outfmt.format));
+		hashState.Update((const uint8*)&outfmt.mipmap,sizeof(outfmt.mipmap));
+	}
+}
+
+
+//! @brief Compute mAssemblyHash from current assembly data
+void Substance::Details::LinkDataAssembly::updateAssemblyHash()
+{
+	FSHA1::HashBuffer(
+		mAssembly.data(),
+		mAssembly.size(),
+		mAssemblyHash);
+}
+
+
 //! @brief Force output format/mipmap
 //! @param uid Output uid
 //! @param format New output format
@@ -102,6 +130,54 @@ Substance::Details::LinkDataStacking::LinkDataStacking(
 }
 	
 	
+//! @brief Accumulate a stable hash of the data pushed to link
+//! @param hashState SHA1 state to update
+void Substance::Details::LinkDataStacking::hash(FSHA1& hashState) const
+{
+	static const uint8 nulltag = 0;
+
+	// Stacked graphs
+	if (mPreLinkData.get()!=NULL)
+	{
+		mPreLinkData->hash(hashState);
+	}
+	else
+	{
+		hashState.Update(&nulltag,sizeof(nulltag));
+	}
+
+	if (mPostLinkData.get()!=NULL)
+	{
+		mPostLinkData->hash(hashState);
+	}
+	else
+	{
+		hashState.Update(&nulltag,sizeof(nulltag));
+	}
+
+	// Stacking options
+	const int32 nonconnected = mOptions.mNonConnected;
+	hashState.Update((const uint8*)&nonconnected,sizeof(nonconnected));
+
+	SBS_VECTOR_FOREACH (const ConnectionsOptions::PairInOut& c, mOptions.mConnections)
+	{
+		hashState.Update((const uint8*)&c.first,sizeof(c.first));
+		hashState.Update((const uint8*)&c.second,sizeof(c.second));
+	}
+
+	SBS_VECTOR_FOREACH (const ConnectionsOptions::PairInOut& fuse, mFuseInputs)
+	{
+		hashState.Update((const uint8*)&fuse.first,sizeof(fuse.first));
+		hashState.Update((const uint8*)&fuse.second,sizeof(fuse.second));
+	}
+
+	SBS_VECTOR_FOREACH (uint32 uid, mDisabledOutputs)
+	{
+		hashState.Update((const uint8*)&uid,sizeof(uid));
+	}
+}
+
+
 //! @brief Push data to link
 //! @param cxt Used to push link data
 bool Substance::Details::LinkDataStacking::push(LinkContext& cxt) const
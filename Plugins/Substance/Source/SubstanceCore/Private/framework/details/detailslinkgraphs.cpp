@@ -23,6 +23,18 @@ bool Substance::Details::LinkGraphs::OrderPredicate::operator()(
 }
 
 
+//! @brief Predicate used for searching per state UID
+struct LinkGraphsUidPredicate
+{
+	bool operator()(
+		const Substance::Details::LinkGraphs::GraphStatePtr& a,
+		uint32 b) const
+	{
+		return a->getUid()<b;
+	}
+};  // struct LinkGraphsUidPredicate
+
+
 //! @brief Merge another link graph w\ redondancies
 void Substance::Details::LinkGraphs::merge(const LinkGraphs& src)
 {
@@ -46,3 +58,21 @@ void Substance::Details::LinkGraphs::merge(const LinkGraphs& src)
 	}
 }
 
+
+//! @brief Search for a graph state per UID
+//! @param stateUid UID of the graph state to search for
+//! @return Return the graph state pointer or NULL if not found
+const Substance::Details::LinkGraphs::GraphStatePtr*
+Substance::Details::LinkGraphs::find(uint32 stateUid) const
+{
+	GraphStates::const_iterator ite = std::lower_bound(
+		graphStates.begin(),
+		graphStates.end(),
+		stateUid,
+		LinkGraphsUidPredicate());
+
+	return ite!=graphStates.end() && (*ite)->getUid()==stateUid ?
+		&*ite :
+		NULL;
+}
+
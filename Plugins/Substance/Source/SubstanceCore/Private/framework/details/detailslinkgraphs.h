@@ -40,6 +40,11 @@ struct LinkGraphs
 	//! @brief Merge another link graph w\ redundancies
 	void merge(const LinkGraphs& src);
 	
+	//! @brief Search for a graph state per UID
+	//! @param stateUid UID of the graph state to search for
+	//! @return Return the graph state pointer or NULL if not found
+	const GraphStatePtr* find(uint32 stateUid) const;
+	
 }; // class LinkGraphs
 
 } // namespace Details
@@ -0,0 +1,333 @@
+//! @file detailsoutputqueue.cpp
+//! @brief Substance Framework lock-free computed outputs queue impl.
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150316
+//! @copyright Allegorithmic. All rights reserved.
+//!
+
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceFOutput.h"
+
+#include "framework/details/detailsoutputqueue.h"
+
+
+//! @brief Constructor
+//! @param capacityLog2 Log2 of the maximum count of queued outputs
+Substance::Details::OutputQueue::OutputQueue(uint32 capacityLog2) :
+	mCells(NULL),
+	mMask((1u<<capacityLog2)-1),
+	mEnqueuePos(0),
+	mDequeuePos(0),
+	mDeferred(NULL)
+{
+	mCells = new Cell[mMask+1];
+	for (uint32 k=0;k<=mMask;++k)
+	{
+		mCells[k].sequence = (int32)k;
+		mCells[k].output = NULL;
+	}
+}
+
+
+//! @brief Destructor
+Substance::Details::OutputQueue::~OutputQueue()
+{
+	delete [] mCells;
+}
+
+
+//! @brief Push a computed output, skipped if already queued
+//! @note Called from render threads
+//! @return Return true if the output is effectively pushed or deferred
+bool Substance::Details::OutputQueue::push(FOutputInstance* output)
+{
+	// De-duplication: only the first producer that flags the output pushes
+	if (FPlatformAtomics::InterlockedCompareExchange(
+		&output->ComputedQueued,ComputedState_Pushing,ComputedState_Idle)!=
+			ComputedState_Idle)
+	{
+		return false;
+	}
+
+	if (!enqueue(output))
+	{
+		// Full: the consumer may be waiting for this thread, do not wait.
+		// Stays flagged, moved into the ring by the consumer later.
+		defer(output);
+		FPlatformAtomics::InterlockedExchange(
+			&output->ComputedQueued,ComputedState_Deferred);
+		return true;
+	}
+
+	// Published, can be popped or removed from now
+	FPlatformAtomics::InterlockedExchange(
+		&output->ComputedQueued,ComputedState_Queued);
+
+	return true;
+}
+
+
+//! @brief Reserve a ring cell and publish an output
+//! @return Return false if the ring is full
+bool Substance::Details::OutputQueue::enqueue(FOutputInstance* output)
+{
+	Cell* cell = NULL;
+	int32 pos = mEnqueuePos;
+	for (;;)
+	{
+		cell = &mCells[(uint32)pos&mMask];
+		const int32 diff = cell->sequence-pos;
+		
+		if (diff==0)
+		{
+			// Free cell, try to reserve it
+			if (FPlatformAtomics::InterlockedCompareExchange(
+				&mEnqueuePos,pos+1,pos)==pos)
+			{
+				break;
+			}
+		}
+		else if (diff<0)
+		{
+			// Full
+			return false;
+		}
+		
+		pos = mEnqueuePos;
+	}
+
+	// Publish
+	cell->output = output;
+	FPlatformMisc::MemoryBarrier();
+	cell->sequence = pos+1;
+
+	return true;
+}
+
+
+//! @brief Link an output to the deferred chain
+void Substance::Details::OutputQueue::defer(FOutputInstance* output)
+{
+	// Producers only link and the consumer only unlinks the whole chain: 
+	// no ABA issue
+	for (;;)
+	{
+		FOutputInstance* head = mDeferred;
+		output->ComputedNext = head;
+		if (FPlatformAtomics::InterlockedCompareExchangePointer(
+			(void**)&mDeferred,output,head)==head)
+		{
+			return;
+		}
+	}
+}
+
+
+//! @brief Move deferred outputs into the ring, as long as it has room
+//! @note Called from user thread only
+void Substance::Details::OutputQueue::retryDeferred()
+{
+	FOutputInstance* output = (FOutputInstance*)
+		FPlatformAtomics::InterlockedExchangePtr((void**)&mDeferred,NULL);
+
+	// Reverse the chain: oldest deferred first
+	FOutputInstance* oldest = NULL;
+	while (output!=NULL)
+	{
+		FOutputInstance* next = output->ComputedNext;
+		output->ComputedNext = oldest;
+		oldest = output;
+		output = next;
+	}
+
+	while (oldest!=NULL)
+	{
+		output = oldest;
+		oldest = output->ComputedNext;
+		output->ComputedNext = NULL;
+
+		// Its producer may not have flagged it as deferred yet
+		while (output->ComputedQueued==ComputedState_Pushing)
+		{
+			FPlatformProcess::Sleep(0.0f);
+		}
+
+		// Deferred outputs are only published by this thread
+		if (enqueue(output))
+		{
+			FPlatformAtomics::InterlockedExchange(
+				&output->ComputedQueued,ComputedState_Queued);
+		}
+		else
+		{
+			defer(output);
+		}
+	}
+}
+
+
+//! @brief Pop the next output
+//! @note Called from user thread only
+//! @return Return the output or NULL if the queue is empty
+Substance::FOutputInstance* Substance::Details::OutputQueue::pop()
+{
+	if (mDeferred!=NULL && !isFull())
+	{
+		retryDeferred();
+	}
+
+	FOutputInstance* output = popRing();
+
+	if (output!=NULL)
+	{
+		release(output);
+	}
+
+	return output;
+}
+
+
+//! @brief Pop several outputs
+//! @param outputs Array to fill with popped outputs
+//! @param maxCount Maximum count of outputs to pop
+//! @note Called from user thread only
+//! @return Return the count of popped outputs
+size_t Substance::Details::OutputQueue::drain(
+	Substance::List<FOutputInstance*>& outputs,
+	size_t maxCount)
+{
+	size_t count = 0;
+	FOutputInstance* output = NULL;
+	while (count<maxCount && (output=pop())!=NULL)
+	{
+		outputs.push(output);
+		++count;
+	}
+
+	return count;
+}
+
+
+//! @brief Remove an output from the queue (deleted output)
+//! @note Called from user thread only
+void Substance::Details::OutputQueue::remove(FOutputInstance* output)
+{
+	for (;;)
+	{
+		const int32 state = FPlatformAtomics::InterlockedCompareExchange(
+			&output->ComputedQueued,ComputedState_Removed,ComputedState_Idle);
+		if (state==ComputedState_Idle || state==ComputedState_Removed)
+		{
+			// Fast path: not queued, later pushes are skipped
+			return;
+		}
+		else if (state==ComputedState_Queued)
+		{
+			break;
+		}
+		else if (state==ComputedState_Deferred)
+		{
+			// Unlink it, producers keep linking others meanwhile
+			FOutputInstance* deferred = (FOutputInstance*)
+				FPlatformAtomics::InterlockedExchangePtr(
+					(void**)&mDeferred,NULL);
+			while (deferred!=NULL)
+			{
+				FOutputInstance* next = deferred->ComputedNext;
+				deferred->ComputedNext = NULL;
+				if (deferred!=output)
+				{
+					defer(deferred);
+				}
+				deferred = next;
+			}
+
+			FPlatformAtomics::InterlockedExchange(
+				&output->ComputedQueued,ComputedState_Removed);
+			return;
+		}
+
+		// A producer is publishing it, it does not wait for this thread
+		FPlatformProcess::Sleep(0.0f);
+	}
+
+	// Tombstone published cells that reference this output, skipped by pop.
+	// Cells still reserved by other producers are not this output's one.
+	const uint32 enqueuePos = (uint32)mEnqueuePos;
+	FPlatformMisc::MemoryBarrier();
+	for (uint32 pos=mDequeuePos;pos!=enqueuePos;++pos)
+	{
+		Cell& cell = mCells[pos&mMask];
+		if (cell.sequence==(int32)(pos+1) && cell.output==output)
+		{
+			cell.output = NULL;
+		}
+	}
+
+	FPlatformAtomics::InterlockedExchange(
+		&output->ComputedQueued,ComputedState_Removed);
+}
+
+
+//! @brief Return true if no output is ready to pop
+//! @note Called from user thread only
+bool Substance::Details::OutputQueue::isEmpty() const
+{
+	const Cell& cell = mCells[mDequeuePos&mMask];
+	return cell.sequence-(int32)(mDequeuePos+1)<0 && mDeferred==NULL;
+}
+
+
+//! @brief Return true if the ring has no free cell
+//! @note Approximative if producers are pushing
+bool Substance::Details::OutputQueue::isFull() const
+{
+	const int32 pos = mEnqueuePos;
+	return mCells[(uint32)pos&mMask].sequence-pos<0;
+}
+
+
+//! @brief Pop the next output of the ring, NULL if empty
+Substance::FOutputInstance* Substance::Details::OutputQueue::popRing()
+{
+	for (;;)
+	{
+		Cell& cell = mCells[mDequeuePos&mMask];
+		if (cell.sequence-(int32)(mDequeuePos+1)<0)
+		{
+			// Empty (or producer still writing)
+			return NULL;
+		}
+
+		FPlatformMisc::MemoryBarrier();
+		FOutputInstance* output = cell.output;
+		cell.output = NULL;
+
+		// Release the cell for producers
+		FPlatformMisc::MemoryBarrier();
+		cell.sequence = (int32)(mDequeuePos+mMask+1);
+		++mDequeuePos;
+
+		if (output!=NULL)
+		{
+			return output;
+		}
+
+		// Removed output, skip it
+	}
+}
+
+
+//! @brief Mark a popped output as not queued
+void Substance::Details::OutputQueue::release(FOutputInstance* output)
+{
+	// Its producer may not have flagged it as published yet
+	while (output->ComputedQueued==ComputedState_Pushing)
+	{
+		FPlatformProcess::Sleep(0.0f);
+	}
+
+	// Can be pushed again from now
+	FPlatformAtomics::InterlockedCompareExchange(
+		&output->ComputedQueued,ComputedState_Idle,ComputedState_Queued);
+}
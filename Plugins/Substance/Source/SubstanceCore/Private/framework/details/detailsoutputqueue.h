@@ -0,0 +1,135 @@
+//! @file detailsoutputqueue.h
+//! @brief Substance Framework lock-free computed outputs queue definition
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150316
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSOUTPUTQUEUE_H
+#define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSOUTPUTQUEUE_H
+
+#include "SubstanceCoreTypedefs.h"
+
+namespace Substance
+{
+
+struct FOutputInstance;
+
+namespace Details
+{
+
+//! @brief Lock-free multiple producers/single consumer queue of computed
+//!		outputs
+//! Producers are render threads (any count of renderers/workers), the 
+//! consumer is the user thread. An output is present at most once in the
+//! queue: FOutputInstance::ComputedQueued state is used for de-duplication
+//! (see ComputedState). Outputs pushed while the ring is full are not
+//! spilled: they stay flagged as deferred, linked through
+//! FOutputInstance::ComputedNext, and the consumer moves them into the ring
+//! once it has free cells. Producers never wait nor lock, and a deferred
+//! output keeps its graph in flight (back-pressure on the scheduler).
+class OutputQueue
+{
+public:
+	//! @brief Constructor
+	//! @param capacityLog2 Log2 of the maximum count of queued outputs
+	OutputQueue(uint32 capacityLog2);
+
+	//! @brief Destructor
+	~OutputQueue();
+
+	//! @brief FOutputInstance::ComputedQueued values
+	enum ComputedState
+	{
+		ComputedState_Idle    = 0,   //!< Not queued
+		ComputedState_Pushing = 1,   //!< A producer is publishing it
+		ComputedState_Queued  = 2,   //!< Published, ready to pop
+		ComputedState_Deferred = 3,  //!< Ring was full, retried by consumer
+		ComputedState_Removed = -1   //!< Removed, cannot be pushed anymore
+	};
+
+	//! @brief Push a computed output, skipped if already queued
+	//! @note Called from render threads
+	//! @return Return true if the output is effectively pushed or deferred
+	//!
+	//! If the ring is full, the output is deferred and retried by pop().
+	bool push(FOutputInstance* output);
+
+	//! @brief Pop the next output
+	//! @note Called from user thread only
+	//! @return Return the output or NULL if the queue is empty
+	FOutputInstance* pop();
+
+	//! @brief Pop several outputs
+	//! @param outputs Array to fill with popped outputs
+	//! @param maxCount Maximum count of outputs to pop
+	//! @note Called from user thread only
+	//! @return Return the count of popped outputs
+	size_t drain(Substance::List<FOutputInstance*>& outputs, size_t maxCount);
+
+	//! @brief Remove an output from the queue (deleted output)
+	//! @note Called from user thread only
+	//!
+	//! Waits for a producer publishing this output, then the output cannot
+	//! be pushed anymore.
+	void remove(FOutputInstance* output);
+
+	//! @brief Return true if no output is ready to pop
+	//! @note Called from user thread only
+	bool isEmpty() const;
+
+protected:
+	//! @brief Queue cell, sequence is used to synchronize producers and 
+	//!		consumer w/o lock
+	struct Cell
+	{
+		volatile int32 sequence;
+		FOutputInstance* volatile output;
+	};
+
+	//! @brief Ring buffer of cells
+	Cell* mCells;
+
+	//! @brief Cells count minus one (power of two)
+	const uint32 mMask;
+
+	//! @brief Next position to push, shared by producers
+	volatile int32 mEnqueuePos;
+
+	//! @brief Next position to pop, consumer only
+	uint32 mDequeuePos;
+
+	//! @brief Last deferred output, chained through ComputedNext
+	//! Producers link outputs, only the consumer unlinks (whole chain).
+	FOutputInstance* volatile mDeferred;
+
+	//! @brief Reserve a ring cell and publish an output
+	//! @return Return false if the ring is full
+	bool enqueue(FOutputInstance* output);
+
+	//! @brief Link an output to the deferred chain
+	void defer(FOutputInstance* output);
+
+	//! @brief Move deferred outputs into the ring, as long as it has room
+	//! @note Called from user thread only
+	void retryDeferred();
+
+	//! @brief Return true if the ring has no free cell
+	//! @note Approximative if producers are pushing
+	bool isFull() const;
+
+	//! @brief Pop the next output of the ring, NULL if empty
+	FOutputInstance* popRing();
+
+	//! @brief Mark a popped output as not queued
+	static void release(FOutputInstance* output);
+
+private:
+	OutputQueue(const OutputQueue&);
+	const OutputQueue& operator=(const OutputQueue&);
+};  // class OutputQueue
+
+
+} // namespace Details
+} // namespace Substance
+
+#endif // ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSOUTPUTQUEUE_H
@@ -10,6 +10,9 @@
 #include "framework/details/detailsoutputsfilter.h"
 #include "framework/details/detailsrenderjob.h"
 
+#include <algorithm>
+#include <iterator>
+
 
 //! @brief Constructor from RenderJob contains the list of outputs to filter
 Substance::Details::OutputsFilter::OutputsFilter(const RenderJob& src)
@@ -17,3 +20,65 @@ Substance::Details::OutputsFilter::OutputsFilter(const RenderJob& src)
 	src.fill(*this);
 }
 
+
+
+//! @brief Return true if all outputs of other filter are in this one
+bool Substance::Details::OutputsFilter::contains(
+	const OutputsFilter& other) const
+{
+	for (Instances::const_iterator oite = other.instances.begin();
+		oite != other.instances.end(); ++oite)
+	{
+		Instances::const_iterator ite = instances.find(oite->first);
+		if (ite == instances.end() ||
+			!std::includes(
+				ite->second.begin(),
+				ite->second.end(),
+				oite->second.begin(),
+				oite->second.end()))
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+
+//! @brief Return true if at least one instance is in both filters
+bool Substance::Details::OutputsFilter::intersects(
+	const OutputsFilter& other) const
+{
+	for (Instances::const_iterator oite = other.instances.begin();
+		oite != other.instances.end(); ++oite)
+	{
+		if (instances.find(oite->first) != instances.end())
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+//! @brief Unite other filter outputs into this one
+void Substance::Details::OutputsFilter::merge(const OutputsFilter& other)
+{
+	for (Instances::const_iterator oite = other.instances.begin();
+		oite != other.instances.end(); ++oite)
+	{
+		Outputs &instouts = instances[oite->first];
+		Outputs mergedouts;
+		mergedouts.reserve(instouts.size()+oite->second.size());
+		
+		std::set_union(
+			instouts.begin(),
+			instouts.end(),
+			oite->second.begin(),
+			oite->second.end(),
+			std::back_inserter(mergedouts));
+		
+		instouts.swap(mergedouts);
+	}
+}
@@ -33,6 +33,15 @@ struct OutputsFilter
 	//! @brief Constructor from RenderJob contains the list of outputs to filter
 	OutputsFilter(const RenderJob& src);
 	
+	//! @brief Return true if all outputs of other filter are in this one
+	bool contains(const OutputsFilter& other) const;
+	
+	//! @brief Return true if at least one instance is in both filters
+	bool intersects(const OutputsFilter& other) const;
+	
+	//! @brief Unite other filter outputs into this one
+	void merge(const OutputsFilter& other);
+	
 	//! @brief List of outputs to filter per Instance UID
 	//! Outputs are GraphState/GraphInstance order indices.
 	Instances instances;
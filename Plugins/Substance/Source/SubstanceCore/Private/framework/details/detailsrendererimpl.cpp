@@ -8,7 +8,6 @@
 #include "SubstanceSettings.h"
 
 #include "framework/details/detailscomputation.h"
-#include "framework/details/detailsduplicatejob.h"
 #include "framework/details/detailsrendererimpl.h"
 #include "framework/details/detailsrenderjob.h"
 #include "framework/details/detailsoutputsfilter.h"
@@ -27,11 +26,20 @@ Substance::Details::RendererImpl::RendererImpl(
 	mHold(false),
 	mCancelOccur(false),
 	mPendingHardRsc(false),
+	mPendingRelink(false),
+	mPendingTrim(false),
+	mTrimTarget(0),
 	mExitRender(false),
 	mUserWaiting(false),
 	mEngineInitialized(false),
 	mRenderCallbacks(NULL),
-	mRenderJobUid(0)
+	mRenderJobUid(0),
+	mRenderOptions(renderOptions),
+	mOptionsGeneration(0),
+	mAppliedGeneration(0),
+	mSettingsGeneration(RenderOptions::getSettingsGeneration()),
+	mUserOptions(false),
+	mCoresLimit(0)
 {
 }
 
@@ -113,7 +121,8 @@ void Substance::Details::RendererImpl::waitRender()
 	{
 		Sync::unique_lock slock(mMainMutex);
 		
-		if (mRenderState==RenderState_OnGoing || (mCurrentJob!=NULL && !mHold))
+		if (mRenderState==RenderState_OnGoing || 
+			((mCurrentJob!=NULL || hasQueuedJobs()) && !mHold))
 		{
 			mUserWaiting = true;
 			mCondVarUser.wait(slock);
@@ -141,18 +150,24 @@ bool Substance::Details::RendererImpl::push(FGraphInstance* graphInstance)
 
 //! @brief Launch computation
 //! @param options RunOptions flags combination
+//! @param priority Priority class of the render job
+//! @param future Completion handle notified when the job is done, can be
+//!		NULL. Not notified if no job is run.
 //! @return Return UID of render job or 0 if not pushed computation to run
 uint32 Substance::Details::RendererImpl::run(
-	unsigned int options)
+	unsigned int options,
+	Renderer::RunPriority priority,
+	RenderFuture* future)
 {
 	// Cleanup deprecated jobs
 	cleanup();
 
-	// Force run if pending hard resource switch
-	if (mPendingHardRsc)
+	// Force run if pending hard resource switch or states released
+	if (mPendingHardRsc || mPendingRelink)
 	{
 		mPendingHardRsc = false;
-		if (mRenderJobs.empty())
+		if (mRenderJobs.empty() ||
+			mRenderJobs.back()->getState()!=RenderJob::State_Setup)
 		{
 			// Create empty render job (implies engine start w\ outputs)
 			mRenderJobs.push_back(new RenderJob(++mRenderJobUid,mRenderCallbacks));
@@ -170,132 +185,26 @@ uint32 Substance::Details::RendererImpl::run(
 		}
 	}
 
-	// Skip already canceled jobs
-	// and currently computed job if Run_PreserveRun flag is present
-	RenderJob *curjob = mCurrentJob;    // Current job (can diverge)
-	RenderJob *lastjob = curjob;        // Last job in render list
-	while (curjob!=NULL && 
-		(curjob->isCanceled() ||
-		((options&Renderer::Run_PreserveRun)!=0 &&
-		curjob->getState()==RenderJob::State_Computing)))	
-	{
-		lastjob = curjob;
-		curjob = curjob->getNextJob();
-	}
-
-	// Retrieve last job in render list
-	while (lastjob!=NULL && lastjob->getNextJob()!=NULL)
-	{
-		lastjob = lastjob->getNextJob();
-	}
-	
 	RenderJob *newjob = mRenderJobs.back(); // Currently pushed render job
-	RenderJob *begjob = newjob;             // List of new jobs: begin
 	
 	// Fill list of graphs to link
 	newjob->snapshotStates(mStates);
-		
-	if (curjob!=NULL && 
-		(options&(Renderer::Run_Replace|Renderer::Run_First))!=0 &&
-		curjob->cancel(true))      // Proceed only if really canceled (diverge)
+
+	if (mPendingRelink)
 	{
-		// Non empty render job list
-		// And must cancel previous computation
-		
-		// Notify render loop that cancel operation occur
-		mCancelOccur = true;
-		
-		if ((options&Renderer::Run_PreserveRun)==0)
-		{
-			// Stop engine if current computation is not preserved
-			mEngine.stop();
-		}
-		
-		const bool newfirst = (options&Renderer::Run_First)!=0; 
-		std::auto_ptr<OutputsFilter> filter((options&Renderer::Run_Replace)!=0 ? 
-			new OutputsFilter(*newjob) : 
-			NULL);
-			
-		// Duplicate job context / accumulation structure
-		DuplicateJob dup(
-			newjob->getLinkGraphs(),
-			filter.get(),
-			mStates,
-			newfirst);   // Update state if new first
-		
-		if (!newfirst)
-		{
-			mRenderJobs.pop_back();       // Insert other jobs before
-		}
-		
-		// Accumulate reversed state -> just before curjob
-		RenderJob *srcjob;
-		for (srcjob=curjob;srcjob!=NULL;srcjob=srcjob->getNextJob()) 
-		{
-			srcjob->prependRevertedDelta(dup);
-		}
-		
-		// Duplicate job
-		// Iterate on canceled jobs
-		RenderJob *prevdupjob = NULL;
-		for (srcjob=curjob;srcjob!=NULL;srcjob=srcjob->getNextJob()) 
-		{
-			// Duplicate canceled
-			RenderJob *dupjob = new RenderJob(*srcjob,dup,mRenderCallbacks);
-				
-			if (dupjob->isEmpty())
-			{
-				// All outputs filtered
-				delete dupjob;
-			}
-			else 
-			{
-				// Valid, at least one output
-				if (prevdupjob==NULL)
-				{
-					// First job created, update inputs state
-					if (newfirst)
-					{	
-						// Activate duplicated job w/ current as previous
-						dupjob->activate(newjob);
-					}
-					else
-					{
-						// Record as first
-						begjob = dupjob;
-					}   
-				}
-				else
-				{
-					check(prevdupjob!=NULL);
-					dupjob->activate(prevdupjob);
-				}
-				
-				prevdupjob = dupjob;      // Store prev for next activation
-			}	   
-		}
-		
-		// Push new job at the end except if First flag is set
-		if (!newfirst)
-		{
-			// New job at the end of list
-			mRenderJobs.push_back(newjob);   // At the end
-			
-			// Activate
-			if (begjob!=newjob)              
-			{
-				// Not in case that nothing pushed
-				check(prevdupjob!=NULL);
-				newjob->activate(prevdupjob);  // Activate (last, not first)
-			}
-			
-			check(!dup.hasDelta());         // State must be reverted
-		}
+		// Prune released states from SBSBIN
+		newjob->forceLink();
+		mPendingRelink = false;
+	}
+
+	// Activate, not chained: render thread takes queued jobs one by one
+	newjob->activate(NULL);
+
+	// Attach completion handle before the render thread can process it
+	if (future!=NULL)
+	{
+		newjob->setFuture(future);
 	}
-		
-	// Activate the first job (render thread can view and consume them)
-	// Active the first in LAST! Otherwise thread unsafe behavior
-	begjob->activate(lastjob);
 		
 	bool needlaunch = false;
 	const bool synchrun = (options&Renderer::Run_Asynchronous)==0;
@@ -303,12 +212,12 @@ uint32 Substance::Details::RendererImpl::run(
 	{
 		// Thread safe modifications	
 		Sync::unique_lock slock(mMainMutex);
-		if (mCurrentJob==NULL &&                           // No more computation
-			begjob->getState()==RenderJob::State_Pending)  // Not already processed
-		{
-			// Set as current job if no current computations
-			mCurrentJob = begjob;
-		}
+
+		enqueueJob(
+			newjob,
+			priority,
+			(options&Renderer::Run_First)!=0,
+			(options&Renderer::Run_Replace)!=0);
 		
 		mHold = mHold && !synchrun;
 		if (!mHold)
@@ -335,6 +244,135 @@ uint32 Substance::Details::RendererImpl::run(
 }
 
 
+//! @brief Insert an activated job into its priority class queue
+//! @param job The job to enqueue
+//! @param priority Priority class of the job
+//! @param first If true, insert before the jobs of the same class
+//! @param replace If true, queued jobs which outputs are all superseded
+//!		by this job are canceled (only inputs are processed)
+//! @pre mMainMutex Must be locked
+//! @note Called from user thread
+void Substance::Details::RendererImpl::enqueueJob(
+	RenderJob* job,
+	Renderer::RunPriority priority,
+	bool first,
+	bool replace)
+{
+	check(priority<Renderer::Priority_Count);
+
+	OutputsFilter jobfilter(*job);
+	
+	// Cancel superseded queued jobs: not yet pulled, no engine stop needed.
+	// Canceled jobs stay queued, their inputs are still processed (state
+	// coherency).
+	if (replace)
+	{
+		for (size_t p=0;p<Renderer::Priority_Count;++p)
+		{
+			SBS_VECTOR_FOREACH (RenderJob* queuedjob,mQueuedJobs[p])
+			{
+				if (!queuedjob->isCanceled() &&
+					jobfilter.contains(OutputsFilter(*queuedjob)))
+				{
+					queuedjob->cancel();
+				}
+			}
+		}
+	}
+	
+	// Queued jobs that will be processed after this one: lower classes and
+	// same class if inserted first
+	QueuedJobs afterjobs;
+	for (size_t p=0;p<=(size_t)priority;++p)
+	{
+		if (p<(size_t)priority || first)
+		{
+			afterjobs.insert(
+				afterjobs.end(),
+				mQueuedJobs[p].begin(),
+				mQueuedJobs[p].end());
+		}
+	}
+	
+	// Promote jobs sharing instances, scan from the most recent one to
+	// propagate dependencies through older jobs
+	std::sort(afterjobs.begin(),afterjobs.end(),RenderJob::OrderPredicate());
+	QueuedJobs promoted;
+	SBS_VECTOR_REVERSE_FOREACH (RenderJob* afterjob,afterjobs)
+	{
+		OutputsFilter afterfilter(*afterjob);
+		if (jobfilter.intersects(afterfilter))
+		{
+			jobfilter.merge(afterfilter);
+			promoted.push_front(afterjob);
+			
+			for (size_t p=0;p<=(size_t)priority;++p)
+			{
+				QueuedJobs::iterator ite = std::find(
+					mQueuedJobs[p].begin(),
+					mQueuedJobs[p].end(),
+					afterjob);
+				if (ite!=mQueuedJobs[p].end())
+				{
+					mQueuedJobs[p].erase(ite);
+					break;
+				}
+			}
+		}
+	}
+	
+	QueuedJobs &queue = mQueuedJobs[priority];
+	if (first)
+	{
+		queue.push_front(job);
+		queue.insert(queue.begin(),promoted.begin(),promoted.end());
+	}
+	else
+	{
+		queue.insert(queue.end(),promoted.begin(),promoted.end());
+		queue.push_back(job);
+	}
+}
+
+
+//! @brief Take the next job to process from queues
+//! @pre mMainMutex Must be locked
+//! @note Called from render thread
+//! @return Return the first job of the highest non-empty class or NULL
+Substance::Details::RenderJob*
+Substance::Details::RendererImpl::dequeueJob()
+{
+	for (size_t p=Renderer::Priority_Count;p>0;--p)
+	{
+		QueuedJobs &queue = mQueuedJobs[p-1];
+		if (!queue.empty())
+		{
+			RenderJob *job = queue.front();
+			queue.pop_front();
+			return job;
+		}
+	}
+	
+	return NULL;
+}
+
+
+//! @brief Return true if at least one job queued
+//! @pre mMainMutex Must be locked
+bool Substance::Details::RendererImpl::hasQueuedJobs() const
+{
+	for (size_t p=0;p<Renderer::Priority_Count;++p)
+	{
+		if (!mQueuedJobs[p].empty())
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
 //! @brief Cancel a computation or all computations
 //! @param runUid UID of the render job to cancel (returned by run()), set
 //!		to 0 to cancel ALL jobs.
@@ -346,6 +384,7 @@ bool Substance::Details::RendererImpl::cancel(uint32 runUid)
 	
 	if (mCurrentJob!=NULL)
 	{
+		bool currentCancel = false;
 		if (runUid!=0)
 		{	
 			// Search for job to cancel
@@ -354,7 +393,7 @@ bool Substance::Details::RendererImpl::cancel(uint32 runUid)
 				if (runUid==rjob->getUid())
 				{
 					// Cancel this job
-					hasCancel = rjob->cancel();
+					currentCancel = rjob->cancel();
 					break;
 				}
 			}
@@ -362,10 +401,10 @@ bool Substance::Details::RendererImpl::cancel(uint32 runUid)
 		else
 		{
 			// Cancel all
-			hasCancel = mCurrentJob->cancel(true);
+			currentCancel = mCurrentJob->cancel(true);
 		}
 		
-		if (hasCancel)
+		if (currentCancel)
 		{
 			// Notify render loop that cancel operation occur
 			mCancelOccur = true;
@@ -373,6 +412,20 @@ bool Substance::Details::RendererImpl::cancel(uint32 runUid)
 			// Stop engine if necessary
 			mEngine.stop();
 		}
+		
+		hasCancel = currentCancel;
+	}
+	
+	// Queued jobs: not yet pulled, still processed for inputs only
+	for (size_t p=0;p<Renderer::Priority_Count;++p)
+	{
+		SBS_VECTOR_FOREACH (RenderJob* queuedjob,mQueuedJobs[p])
+		{
+			if (runUid==0 || runUid==queuedjob->getUid())
+			{
+				hasCancel = queuedjob->cancel() || hasCancel;
+			}
+		}
 	}
 	
 	return hasCancel;
@@ -386,6 +439,37 @@ void Substance::Details::RendererImpl::clearCache()
 }
 
 
+//! @brief Release engine intermediate caches and pending textures
+//! @param targetBytes Memory budget to shrink the engine caches to, 0 to
+//!		release all of them.
+//! @note This function can be called at any time, from any thread.
+void Substance::Details::RendererImpl::trim(size_t targetBytes)
+{
+	Sync::unique_lock slock(mMainMutex);
+
+	// Processed by render thread once starved, the engine handle is only 
+	// used from render thread
+	mTrimTarget = targetBytes;
+	mPendingTrim = true;
+	wakeupRender();
+}
+
+
+//! @brief Release the graph states of a package moved to another worker
+//! @param packageGuid GUID of the released package
+//! @note Called from user thread
+//!
+//! Next run relinks the remaining states (SBSBIN w/o the package).
+void Substance::Details::RendererImpl::releasePackage(
+	const substanceGuid_t& packageGuid)
+{
+	if (mStates.releasePackage(packageGuid))
+	{
+		mPendingRelink = true;
+	}
+}
+
+
 //! @brief Return if a computation is pending
 //! @param runUid UID of the render job to retreive state (returned by run())
 bool Substance::Details::RendererImpl::isPending(uint32 runUid) const
@@ -421,7 +505,7 @@ void Substance::Details::RendererImpl::resume()
 	{
 		Sync::unique_lock slock(mMainMutex);
 	
-		const bool needwakeup = mHold && mCurrentJob!=NULL;
+		const bool needwakeup = mHold && (mCurrentJob!=NULL || hasQueuedJobs());
 
 		mHold = false;
 
@@ -435,7 +519,6 @@ void Substance::Details::RendererImpl::resume()
 	if (needlaunch)
 	{
 		check(!mHold);
-		check(mCurrentJob != NULL);
 
 		launchRender();
 	}
@@ -464,7 +547,78 @@ void Substance::Details::RendererImpl::flush()
 void Substance::Details::RendererImpl::setOptions(
 	const RenderOptions& renderOptions)
 {
-	mPendingHardRsc = !mEngine.setOptions(renderOptions);
+	Sync::unique_lock slock(mMainMutex);
+
+	assignOptions(renderOptions);
+	mUserOptions = true;
+	++mOptionsGeneration;
+
+	// Force next run if idle: hard resources switched by render thread
+	mPendingHardRsc = true;
+}
+
+
+//! @brief Follow USubstanceSettings values again
+//! @note This function can be called at any time, from any thread.
+void Substance::Details::RendererImpl::resetOptions()
+{
+	Sync::unique_lock slock(mMainMutex);
+
+	if (mUserOptions)
+	{
+		mUserOptions = false;
+		assignOptions(RenderOptions());
+		mSettingsGeneration = RenderOptions::getSettingsGeneration();
+		++mOptionsGeneration;
+		mPendingHardRsc = true;
+	}
+}
+
+
+//! @brief Limit the CPU cores count used by the engine
+//! @param coresCount Maximum cores count of this engine (share of the
+//!		pool limit), 0 to remove the limit
+//! @note This function can be called at any time, from any thread.
+void Substance::Details::RendererImpl::setCoresLimit(size_t coresCount)
+{
+	Sync::unique_lock slock(mMainMutex);
+
+	if (coresCount!=mCoresLimit)
+	{
+		mCoresLimit = coresCount;
+		++mOptionsGeneration;
+	}
+}
+
+
+//! @brief Set current render options, workers count preserved
+//! @pre mMainMutex Must be locked
+void Substance::Details::RendererImpl::assignOptions(
+	const RenderOptions& renderOptions)
+{
+	// Workers count is fixed at pool creation
+	const size_t workersCount = mRenderOptions.mWorkersCount;
+	mRenderOptions = renderOptions;
+	mRenderOptions.mWorkersCount = workersCount;
+}
+
+
+//! @brief Update render options from settings if they changed
+//! @pre mMainMutex Must be locked
+//! @note Called from render thread
+//! @return Return true if options must be applied to engine
+bool Substance::Details::RendererImpl::updateOptions()
+{
+	const uint32 settingsGeneration = RenderOptions::getSettingsGeneration();
+	if (!mUserOptions && settingsGeneration!=mSettingsGeneration)
+	{
+		// Settings edited: read them again
+		assignOptions(RenderOptions());
+		mSettingsGeneration = settingsGeneration;
+		++mOptionsGeneration;
+	}
+
+	return mOptionsGeneration!=mAppliedGeneration;
 }
 
 //! @brief Set user callbacks
@@ -521,11 +675,20 @@ void Substance::Details::RendererImpl::launchRender()
 //! @note Called from user thread
 void Substance::Details::RendererImpl::cleanup()
 {
-	while (!mRenderJobs.empty() &&
-		mRenderJobs.front()->getState()==RenderJob::State_Done)
+	// Jobs are not processed in push order (priority classes): remove all
+	// done jobs, not only the front ones
+	RenderJobs::iterator ite = mRenderJobs.begin();
+	while (ite!=mRenderJobs.end())
 	{
-		delete mRenderJobs.front();
-		mRenderJobs.pop_front();
+		if ((*ite)->getState()==RenderJob::State_Done)
+		{
+			delete *ite;
+			ite = mRenderJobs.erase(ite);
+		}
+		else
+		{
+			++ite;
+		}
 	}
 }
 
@@ -552,6 +715,8 @@ void Substance::Details::RendererImpl::renderLoop(bool waitAndLoop)
 {
 	RenderJob* nextJob = NULL;       // Next job to proceed
 	bool nextAvailable = false;      // Flag: next job available
+	bool trimRequired = false;       // Flag: trim() to process
+	size_t trimTarget = 0;           // Memory budget of trim()
 	
 	while (1)
 	{
@@ -570,14 +735,24 @@ void Substance::Details::RendererImpl::renderLoop(bool waitAndLoop)
 			
 			while (mExitRender || 
 				mHold || 
-				mCurrentJob==NULL)
+				(mCurrentJob==NULL && (mCurrentJob=dequeueJob())==NULL))
 			{
 				if (mExitRender)
 				{
 					mEngine.releaseEngine();        // Release engine
 					mExitRender = false;            // Exit render taken account
+					mPendingTrim = false;           // Nothing left to trim
 					waitAndLoop = false;            // Exit loop
 				}
+				else if (mPendingTrim && mCurrentJob==NULL && !hasQueuedJobs())
+				{
+					// No job left: trim out of mMainMutex (synchronous
+					// engine switches), user thread not blocked meanwhile
+					trimTarget = mTrimTarget;
+					mPendingTrim = false;
+					trimRequired = true;
+					break;
+				}
 				
 				if (mUserWaiting)
 				{
@@ -597,17 +772,26 @@ void Substance::Details::RendererImpl::renderLoop(bool waitAndLoop)
 			}
 
 			mRenderState = RenderState_OnGoing;
+
+			// Switch hardware resources only if options changed, processed
+			// by next computation
+			if (updateOptions())
+			{
+				mAppliedGeneration = mOptionsGeneration;
+				mEngine.setOptions(mRenderOptions,mCoresLimit);
+			}
+		}
+
+		if (trimRequired)
+		{
+			// Render thread is the only user of the engine handle
+			mEngine.trim(trimTarget);
+			trimRequired = false;
+			continue;
 		}
 
 		// Release pending textures
 		mEngine.releaseTextures();
-		
-		// memory limitation for the handle, the RenderOptions object 
-		// is created using the values set in the settings
-		Substance::RenderOptions renderOptions; 
-		
-		// Update render options
-		mPendingHardRsc = mEngine.setOptions(renderOptions);
 
 		// Process current job
 		nextJob = processJob(mCurrentJob);
@@ -15,6 +15,8 @@
 #include "SubstanceFGraph.h"
 #include "Engine.h"
 
+#include "framework/renderer.h"
+
 #include <deque>
 
 namespace Substance
@@ -40,8 +42,14 @@ public:
 	
 	//! @brief Launch computation
 	//! @param options Renderer::RunOption flags combination
+	//! @param priority Priority class of the render job
+	//! @param future Completion handle notified when the job is done, can be
+	//!		NULL. Not notified if no job is run.
 	//! @return Return UID of render job or 0 if not pushed computation to run
-	uint32 run(unsigned int options);
+	uint32 run(
+		unsigned int options,
+		Renderer::RunPriority priority = Renderer::Priority_Default,
+		RenderFuture* future = NULL);
 	
 	//! @brief Cancel a computation or all computations
 	//! @param runUid UID of the render job to cancel (returned by run()), set
@@ -51,7 +59,23 @@ public:
 
 	//! @brief Clear the substance cache
 	void clearCache();
+
+	//! @brief Release engine intermediate caches and pending textures
+	//! @param targetBytes Memory budget to shrink the engine caches to, 0 to
+	//!		release all of them.
+	//! @note This function can be called at any time, from any thread.
+	//!
+	//! Posted to the render thread, processed once no job is left (skipped
+	//! if jobs are pushed meanwhile).
+	void trim(size_t targetBytes);
 	
+	//! @brief Release the graph states of a package moved to another worker
+	//! @param packageGuid GUID of the released package
+	//! @note Called from user thread
+	//!
+	//! Next run relinks the remaining states (SBSBIN w/o the package).
+	void releasePackage(const substanceGuid_t& packageGuid);
+
 	//! @brief Return if a computation is pending
 	//! @param runUid UID of the render job to retrieve state (returned by run())
 	bool isPending(uint32 runUid) const;
@@ -68,8 +92,23 @@ public:
 	//! @brief Set new memory budget and CPU usage.
 	//! @param renderOptions New render options to use.
 	//! @note This function can be called at any time, from any thread.
+	//!
+	//! Overrides settings values until resetOptions(). Options are applied
+	//! by the render thread at next render job boundary.
 	void setOptions(const RenderOptions& renderOptions);
 
+	//! @brief Follow USubstanceSettings values again
+	//! @note This function can be called at any time, from any thread.
+	void resetOptions();
+
+	//! @brief Limit the CPU cores count used by the engine
+	//! @param coresCount Maximum cores count of this engine (share of the
+	//!		pool limit), 0 to remove the limit
+	//! @note This function can be called at any time, from any thread.
+	//!
+	//! Applied at next render job boundary (cores governor).
+	void setCoresLimit(size_t coresCount);
+
 	//! @brief Set user render callbacks
 	//! @param callbacks Pointer on the user callbacks concrete structure 
 	//! 	instance or NULL.
@@ -88,6 +127,9 @@ protected:
 
 	//! @brief Render jobs list container
 	typedef std::deque<RenderJob*> RenderJobs;
+
+	//! @brief Queued render jobs container
+	typedef std::deque<RenderJob*> QueuedJobs;
 	
 	//! @brief Current graphs state
 	States mStates;
@@ -99,10 +141,17 @@ protected:
 	//! @note Container modification are always done in user thread
 	RenderJobs mRenderJobs;
 	
-	//! @brief First render job to proceed by render thread
+	//! @brief Activated render jobs not yet taken by render thread, per
+	//!		priority class. FIFO order inside a class.
+	//! Render thread takes jobs one by one from the highest non-empty class,
+	//! higher classes preempt lower ones at render job granularity.
 	//! R/W access thread safety ensure by mMainMutex.
-	//! If NULL Render thread is waiting for pending render job (rendering 
-	//! thread is blocked in mCondVarRender).
+	QueuedJobs mQueuedJobs[Renderer::Priority_Count];
+	
+	//! @brief Render job currently processed by render thread
+	//! R/W access thread safety ensure by mMainMutex.
+	//! If NULL Render thread takes the next queued job or is waiting for 
+	//! pending render job (rendering thread is blocked in mCondVarRender).
 	RenderJob *volatile mCurrentJob;
 	
 	//! @brief Current/required render process state
@@ -121,6 +170,19 @@ protected:
 	//! Can be set from any thread. Unset from render or user thread.
 	volatile bool mPendingHardRsc;
 
+	//! @brief States released, relink required at next run (releasePackage())
+	//! Only used from user thread.
+	bool mPendingRelink;
+
+	//! @brief Engine trim required by user (trim())
+	//! Set from user thread, unset when processed by render thread.
+	//! R/W access thread safety ensure by mMainMutex.
+	bool mPendingTrim;
+
+	//! @brief Memory budget of the pending trim
+	//! R/W access thread safety ensure by mMainMutex.
+	size_t mTrimTarget;
+
 	//! @brief Exit render and engine release required by user
 	//! Set from user thread (destroy or switch engine), unset when taken into
 	//!	account by render loop (render thread).
@@ -151,6 +213,40 @@ protected:
 
 	//! @brief Current Render job UID
 	uint32 mRenderJobUid;
+
+	//! @brief Current render options
+	//! R/W access thread safety ensure by mMainMutex.
+	RenderOptions mRenderOptions;
+
+	//! @brief Render options generation, incremented at each change
+	//! R/W access thread safety ensure by mMainMutex.
+	uint32 mOptionsGeneration;
+
+	//! @brief Render options generation applied to engine
+	//! Render thread usage only.
+	uint32 mAppliedGeneration;
+
+	//! @brief Settings generation mRenderOptions was read from
+	//! R/W access thread safety ensure by mMainMutex.
+	uint32 mSettingsGeneration;
+
+	//! @brief Options set by user (setOptions()), settings not followed
+	//! R/W access thread safety ensure by mMainMutex.
+	bool mUserOptions;
+
+	//! @brief Maximum CPU cores count of this engine, 0 if no limit
+	//! R/W access thread safety ensure by mMainMutex.
+	size_t mCoresLimit;
+
+	//! @brief Set current render options, workers count preserved
+	//! @pre mMainMutex Must be locked
+	void assignOptions(const RenderOptions& renderOptions);
+
+	//! @brief Update render options from settings if they changed
+	//! @pre mMainMutex Must be locked
+	//! @note Called from render thread
+	//! @return Return true if options must be applied to engine
+	bool updateOptions();
 		
 	//! @brief Call process callback or create up render thread
 	//! @pre mMainMutex Must be NOT locked, render thread must be currently
@@ -168,6 +264,34 @@ protected:
 	//! @brief Clean consumed render jobs
 	//! @note Called from user thread
 	void cleanup();
+
+	//! @brief Insert an activated job into its priority class queue
+	//! @param job The job to enqueue
+	//! @param priority Priority class of the job
+	//! @param first If true, insert before the jobs of the same class
+	//! @param replace If true, queued jobs which outputs are all superseded
+	//!		by this job are canceled (only inputs are processed)
+	//! @pre mMainMutex Must be locked
+	//! @note Called from user thread
+	//!
+	//! Queued jobs that share graph instances w/ this job and that would be
+	//! processed after it are promoted just before it: input delta states
+	//! must be applied in push order.
+	void enqueueJob(
+		RenderJob* job,
+		Renderer::RunPriority priority,
+		bool first,
+		bool replace);
+
+	//! @brief Take the next job to process from queues
+	//! @pre mMainMutex Must be locked
+	//! @note Called from render thread
+	//! @return Return the first job of the highest non-empty class or NULL
+	RenderJob* dequeueJob();
+
+	//! @brief Return true if at least one job queued
+	//! @pre mMainMutex Must be locked
+	bool hasQueuedJobs() const;
 	
 	//! @brief Release engine and terminates render thread
 	//! If no thread created and engine need to be released, call
@@ -0,0 +1,421 @@
+//! @file detailsrendererpool.cpp
+//! @brief The Substance renderer pool of engine workers implementation
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150310
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+#include "SubstanceFGraph.h"
+#include "SubstanceFPackage.h"
+
+#include "framework/details/detailsrendererpool.h"
+#include "framework/details/detailsrendererimpl.h"
+#include "framework/renderer.h"
+#include "framework/renderopt.h"
+
+#include <algorithm>
+
+
+//! @brief Default constructor
+//! @param renderOptions Initial render options, the workers count is
+//!		read from RenderOptions::mWorkersCount.
+Substance::Details::RendererPool::RendererPool(
+		const RenderOptions& renderOptions) :
+	mRunUid(0),
+	mCoresLimit(0)
+{
+	const size_t workersCount = std::max<size_t>(renderOptions.mWorkersCount,1);
+
+	mWorkers.resize(workersCount);
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer = new RendererImpl(renderOptions);
+		worker.lastRunUid = 0;
+		worker.pushedCount = 0;
+	}
+}
+
+
+//! @brief Destructor
+Substance::Details::RendererPool::~RendererPool()
+{
+	// Cancel on all workers first, workers are then deleted (flushed) one
+	// by one
+	cancel();
+
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		delete worker.renderer;
+		worker.renderer = NULL;
+	}
+}
+
+
+//! @brief Push graph instance current changes to its worker
+//! @param graphInstance The instance to push dirty outputs
+//! @return Return true if at least one dirty output
+bool Substance::Details::RendererPool::push(FGraphInstance* graphInstance)
+{
+	const size_t windex = mWorkers.size()>1 ?
+		selectWorker(graphInstance->Desc->Parent->Guid) :
+		0;
+
+	Worker& worker = mWorkers[windex];
+	if (worker.renderer->push(graphInstance))
+	{
+		++worker.pushedCount;
+		return true;
+	}
+
+	return false;
+}
+
+
+//! @brief Launch computation on all workers w/ pushed instances
+//! @param options Renderer::RunOption flags combination
+//! @param priority Priority class of the computation
+//! @param future Completion handle of the run, can be NULL. Kept until
+//!		its continuations are dispatched.
+//! @return Return UID of pool run or 0 if not pushed computation to run
+uint32 Substance::Details::RendererPool::run(
+	unsigned int options,
+	Renderer::RunPriority priority,
+	const RenderFuture::SPtr& future)
+{
+	// Remove deprecated runs
+	cleanup();
+
+	// All workers run asynchronously, synchronous run waits for all of them
+	// after launch
+	const bool synchrun = (options&Renderer::Run_Asynchronous)==0;
+
+	// Hold the handle while launching: not done before all workers ran
+	if (future)
+	{
+		future->addJob();
+		mFutures.push_back(future);
+	}
+
+	WorkerRuns workerRuns;
+	for (size_t windex=0;windex<mWorkers.size();++windex)
+	{
+		// Run is also called on workers w/o pushed instances: forces pending
+		// hard resources switch
+		Worker& worker = mWorkers[windex];
+		const uint32 runUid = worker.renderer->run(
+			options|Renderer::Run_Asynchronous,
+			priority,
+			future.get());
+		worker.pushedCount = 0;
+
+		if (runUid!=0)
+		{
+			worker.lastRunUid = runUid;
+			workerRuns.push_back(std::make_pair(windex,runUid));
+		}
+	}
+
+	if (!workerRuns.empty())
+	{
+		mRuns[++mRunUid] = workerRuns;
+	}
+
+	if (future)
+	{
+		future->mRunUid = workerRuns.empty() ? 0 : mRunUid;
+		future->jobDone(false);
+	}
+
+	if (synchrun)
+	{
+		SBS_VECTOR_FOREACH (const WorkerRuns::value_type& wrun,workerRuns)
+		{
+			mWorkers[wrun.first].renderer->flush();
+		}
+	}
+
+	return workerRuns.empty() ? 0 : mRunUid;
+}
+
+
+//! @brief Cancel a computation or all computations
+//! @param runUid UID of the pool run to cancel (returned by run()), set
+//!		to 0 to cancel ALL jobs.
+//! @return Return true if at least one worker job is retrieved (pending)
+bool Substance::Details::RendererPool::cancel(uint32 runUid)
+{
+	bool hasCancel = false;
+
+	if (runUid==0)
+	{
+		SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+		{
+			hasCancel = worker.renderer->cancel() || hasCancel;
+		}
+	}
+	else
+	{
+		Runs::const_iterator ite = mRuns.find(runUid);
+		if (ite!=mRuns.end())
+		{
+			SBS_VECTOR_FOREACH (const WorkerRuns::value_type& wrun,ite->second)
+			{
+				hasCancel = mWorkers[wrun.first].renderer->cancel(wrun.second) ||
+					hasCancel;
+			}
+		}
+	}
+
+	return hasCancel;
+}
+
+
+//! @brief Clear the substance cache of all workers
+void Substance::Details::RendererPool::clearCache()
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->clearCache();
+	}
+}
+
+
+//! @brief Release intermediate caches and pending textures of all workers
+//! @param targetBytes Total memory budget to shrink the caches to, 
+//!		shared between workers, 0 to release all of them.
+//! @note Posted to each worker render thread, processed between jobs
+void Substance::Details::RendererPool::trim(size_t targetBytes)
+{
+	const size_t workerTarget = targetBytes/mWorkers.size();
+
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->trim(workerTarget);
+	}
+}
+
+
+//! @brief Return if a computation is pending on any worker
+//! @param runUid UID of the pool run to retrieve state (returned by run())
+bool Substance::Details::RendererPool::isPending(uint32 runUid) const
+{
+	Runs::const_iterator ite = mRuns.find(runUid);
+	if (ite!=mRuns.end())
+	{
+		SBS_VECTOR_FOREACH (const WorkerRuns::value_type& wrun,ite->second)
+		{
+			if (mWorkers[wrun.first].renderer->isPending(wrun.second))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+//! @brief Fire the continuations of the completed runs
+//! @note Called from user thread
+void Substance::Details::RendererPool::dispatchCompletions()
+{
+	// Continuations can run again: swap first, handles added meanwhile
+	// are kept for next dispatch
+	Futures futures;
+	futures.swap(mFutures);
+
+	SBS_VECTOR_FOREACH (const RenderFuture::SPtr& future,futures)
+	{
+		if (!future->dispatch())
+		{
+			mFutures.push_back(future);
+		}
+	}
+}
+
+
+//! @brief Hold rendering
+void Substance::Details::RendererPool::hold()
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->hold();
+	}
+}
+
+
+//! @brief Continue held rendering
+void Substance::Details::RendererPool::resume()
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->resume();
+	}
+}
+
+
+//! @brief Flush computation, wait for all workers to be complete
+void Substance::Details::RendererPool::flush()
+{
+	// Resume all first: do not serialize held workers
+	resume();
+
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->flush();
+	}
+
+	cleanup();
+
+	dispatchCompletions();
+}
+
+
+//! @brief Set new memory budget and CPU usage, shared by all workers
+//! @param renderOptions New render options to use.
+void Substance::Details::RendererPool::setOptions(
+	const RenderOptions& renderOptions)
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->setOptions(renderOptions);
+	}
+}
+
+
+//! @brief Use USubstanceSettings values again on all workers
+void Substance::Details::RendererPool::resetOptions()
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->resetOptions();
+	}
+}
+
+
+//! @brief Limit the CPU cores count used by all workers
+//! @param coresCount Maximum cores count, 0 to remove the limit
+//!
+//! The limit is split between the active workers, the sum of their cores
+//! never exceeds it. If the limit is lower than the workers count, the 
+//! workers above it are parked: they complete their queued jobs but no 
+//! more instances are dispatched to them.
+void Substance::Details::RendererPool::setCoresLimit(size_t coresCount)
+{
+	mCoresLimit = coresCount;
+
+	const size_t activecount = getActiveCount();
+	for (size_t windex=0;windex<mWorkers.size();++windex)
+	{
+		size_t workercores = 0;
+		if (coresCount!=0)
+		{
+			workercores = windex<activecount ?
+				coresCount/activecount + (windex<coresCount%activecount ? 1 : 0) :
+				1;
+		}
+
+		mWorkers[windex].renderer->setCoresLimit(workercores);
+	}
+}
+
+
+//! @brief Set user render callbacks on all workers
+//! @param callbacks Pointer on the user callbacks concrete structure
+//! 	instance or NULL.
+void Substance::Details::RendererPool::setRenderCallbacks(
+	RenderCallbacks* callbacks)
+{
+	SBS_VECTOR_FOREACH (Worker& worker,mWorkers)
+	{
+		worker.renderer->setRenderCallbacks(callbacks);
+	}
+}
+
+
+//! @brief Select the worker of a package, rebind it if stolen
+//! @param packageGuid GUID of the pushed instance package
+//! @return Return the index of the worker to push into
+size_t Substance::Details::RendererPool::selectWorker(
+	const substanceGuid_t& packageGuid)
+{
+	// Least loaded active worker: prefer idle ones, then less pushed 
+	// instances
+	const size_t activecount = getActiveCount();
+	size_t leastindex = 0;
+	bool leastbusy = true;
+	for (size_t windex=0;windex<activecount;++windex)
+	{
+		const Worker& worker = mWorkers[windex];
+		const bool busy = isBusy(worker);
+		const Worker& least = mWorkers[leastindex];
+		if (windex==0 ||
+			(leastbusy && !busy) ||
+			(leastbusy==busy && worker.pushedCount<least.pushedCount))
+		{
+			leastindex = windex;
+			leastbusy = busy;
+		}
+	}
+
+	Affinities::iterator ite = mAffinities.find(packageGuid);
+	if (ite==mAffinities.end())
+	{
+		// First time this package is seen: bind to least loaded
+		mAffinities.insert(std::make_pair(packageGuid,leastindex));
+		return leastindex;
+	}
+
+	// Owner parked by the cores limit, or still computing its previous run
+	// while an other worker is idle: steal the package (keep the new 
+	// binding, binary stays hot there)
+	const size_t ownerindex = ite->second;
+	if (ownerindex>=activecount ||
+		(ownerindex!=leastindex &&
+		!leastbusy &&
+		mWorkers[ownerindex].pushedCount==0 &&
+		isBusy(mWorkers[ownerindex])))
+	{
+		ite->second = leastindex;
+
+		// Release the package states on previous owner, relinked w/o them
+		mWorkers[ownerindex].renderer->releasePackage(packageGuid);
+	}
+
+	return ite->second;
+}
+
+
+//! @brief Return the count of workers that receive new instances
+//! Workers above the cores limit are parked.
+size_t Substance::Details::RendererPool::getActiveCount() const
+{
+	return mCoresLimit!=0 ?
+		std::min(mCoresLimit,mWorkers.size()) :
+		mWorkers.size();
+}
+
+
+//! @brief Return if the worker is still computing its last run
+bool Substance::Details::RendererPool::isBusy(const Worker& worker) const
+{
+	return worker.lastRunUid!=0 &&
+		worker.renderer->isPending(worker.lastRunUid);
+}
+
+
+//! @brief Remove the pool runs that are no more pending
+void Substance::Details::RendererPool::cleanup()
+{
+	for (Runs::iterator ite=mRuns.begin();ite!=mRuns.end();)
+	{
+		if (isPending(ite->first))
+		{
+			++ite;
+		}
+		else
+		{
+			mRuns.erase(ite++);
+		}
+	}
+}
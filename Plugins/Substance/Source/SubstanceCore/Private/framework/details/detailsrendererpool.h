@@ -0,0 +1,189 @@
+//! @file detailsrendererpool.h
+//! @brief The Substance renderer pool of engine workers
+//! @author Christophe Soum - Allegorithmic
+//! @date 20150310
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERERPOOL_H
+#define _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERERPOOL_H
+
+#include "SubstanceCoreTypedefs.h"
+#include "SubstanceCallbacks.h"
+
+#include "framework/renderer.h"
+
+#include <vector>
+#include <map>
+
+namespace Substance
+{
+
+struct FGraphInstance;
+struct RenderOptions;
+
+namespace Details
+{
+
+class RendererImpl;
+
+//! @brief Pool of concrete renderers, one Engine (linker/handle) per worker
+//! Pushed graph instances are sharded per package: all the instances of a
+//! package are dispatched to the same worker to keep its linked binary hot.
+//! When the worker owning a package is still busy with a previous run and
+//! another worker is idle, the package is rebound to the idle worker (work
+//! stealing at dispatch granularity).
+class RendererPool
+{
+public:
+	//! @brief Default constructor
+	//! @param renderOptions Initial render options, the workers count is
+	//!		read from RenderOptions::mWorkersCount.
+	RendererPool(const RenderOptions& renderOptions);
+
+	//! @brief Destructor
+	~RendererPool();
+
+	//! @brief Push graph instance current changes to its worker
+	//! @param graphInstance The instance to push dirty outputs
+	//! @return Return true if at least one dirty output
+	bool push(FGraphInstance* graphInstance);
+
+	//! @brief Launch computation on all workers w/ pushed instances
+	//! @param options Renderer::RunOption flags combination
+	//! @param priority Priority class of the computation
+	//! @param future Completion handle of the run, can be NULL. Kept until
+	//!		its continuations are dispatched.
+	//! @return Return UID of pool run or 0 if not pushed computation to run
+	uint32 run(
+		unsigned int options,
+		Renderer::RunPriority priority,
+		const RenderFuture::SPtr& future = RenderFuture::SPtr());
+
+	//! @brief Cancel a computation or all computations
+	//! @param runUid UID of the pool run to cancel (returned by run()), set
+	//!		to 0 to cancel ALL jobs.
+	//! @return Return true if at least one worker job is retrieved (pending)
+	bool cancel(uint32 runUid = 0);
+
+	//! @brief Clear the substance cache of all workers
+	void clearCache();
+
+	//! @brief Release intermediate caches and pending textures of all workers
+	//! @param targetBytes Total memory budget to shrink the caches to, 
+	//!		shared between workers, 0 to release all of them.
+	//! @note Posted to each worker render thread, processed between jobs
+	void trim(size_t targetBytes);
+
+	//! @brief Return if a computation is pending on any worker
+	//! @param runUid UID of the pool run to retrieve state (returned by run())
+	bool isPending(uint32 runUid) const;
+
+	//! @brief Fire the continuations of the completed runs
+	//! @note Called from user thread
+	void dispatchCompletions();
+
+	//! @brief Hold rendering
+	void hold();
+
+	//! @brief Continue held rendering
+	void resume();
+
+	//! @brief Flush computation, wait for all workers to be complete
+	void flush();
+
+	//! @brief Set new memory budget and CPU usage, shared by all workers
+	//! @param renderOptions New render options to use.
+	void setOptions(const RenderOptions& renderOptions);
+
+	//! @brief Use USubstanceSettings values again on all workers
+	void resetOptions();
+
+	//! @brief Limit the CPU cores count used by all workers
+	//! @param coresCount Maximum cores count, 0 to remove the limit
+	//!
+	//! The limit is split between the active workers, the sum of their 
+	//! cores never exceeds it. If the limit is lower than the workers count,
+	//! the workers above it are parked: they complete their queued jobs but
+	//! no more instances are dispatched to them.
+	void setCoresLimit(size_t coresCount);
+
+	//! @brief Set user render callbacks on all workers
+	//! @param callbacks Pointer on the user callbacks concrete structure
+	//! 	instance or NULL.
+	void setRenderCallbacks(RenderCallbacks* callbacks);
+
+	//! @brief Accessor on workers count
+	size_t getWorkersCount() const { return mWorkers.size(); }
+
+protected:
+	//! @brief Engine worker: one concrete renderer and its dispatch state
+	struct Worker
+	{
+		//! @brief Concrete renderer (owns Engine and render thread)
+		RendererImpl* renderer;
+
+		//! @brief UID of the last job run on this worker (0 if none)
+		uint32 lastRunUid;
+
+		//! @brief Count of instances pushed since last run
+		size_t pushedCount;
+	};
+
+	//! @brief Workers array
+	typedef std::vector<Worker> Workers;
+
+	//! @brief Package GUID -> worker index
+	typedef std::map<substanceGuid_t,size_t,guid_t_comp> Affinities;
+
+	//! @brief Per worker job UIDs of a pool run: pairs of worker index/UID
+	typedef std::vector<std::pair<size_t,uint32> > WorkerRuns;
+
+	//! @brief Pool run UID -> worker job UIDs
+	typedef std::map<uint32,WorkerRuns> Runs;
+
+	//! @brief Completion handles not yet dispatched
+	typedef std::vector<RenderFuture::SPtr> Futures;
+
+	//! @brief Engine workers
+	Workers mWorkers;
+
+	//! @brief Package affinities, used to shard pushed instances
+	Affinities mAffinities;
+
+	//! @brief Active pool runs
+	Runs mRuns;
+
+	//! @brief Completion handles waiting for dispatch, in run order
+	Futures mFutures;
+
+	//! @brief Last pool run UID
+	uint32 mRunUid;
+
+	//! @brief Maximum cores count of all workers, 0 if no limit
+	size_t mCoresLimit;
+
+	//! @brief Select the worker of a package, rebind it if stolen
+	//! @param packageGuid GUID of the pushed instance package
+	//! @return Return the index of the worker to push into
+	size_t selectWorker(const substanceGuid_t& packageGuid);
+
+	//! @brief Return if the worker is still computing its last run
+	bool isBusy(const Worker& worker) const;
+
+	//! @brief Return the count of workers that receive new instances
+	//! Workers above the cores limit are parked.
+	size_t getActiveCount() const;
+
+	//! @brief Remove the pool runs that are no more pending
+	void cleanup();
+
+private:
+	RendererPool(const RendererPool&);
+	const RendererPool& operator=(const RendererPool&);
+};
+
+
+} // namespace Details
+} // namespace Substance
+
+#endif // _SUBSTANCE_FRAMEWORK_DETAILS_DETAILSRENDERERPOOL_H
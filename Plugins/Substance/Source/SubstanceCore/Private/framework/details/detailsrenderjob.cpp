@@ -10,12 +10,12 @@
 #include "SubstanceFGraph.h"
 
 #include "framework/details/detailsrenderjob.h"
-#include "framework/details/detailsduplicatejob.h"
 #include "framework/details/detailsrenderpushio.h"
 #include "framework/details/detailsgraphstate.h"
 #include "framework/details/detailsstates.h"
 #include "framework/details/detailsengine.h"
 #include "framework/details/detailscomputation.h"
+#include "framework/renderfuture.h"
 
 #include <algorithm>
 
@@ -31,56 +31,22 @@ Substance::Details::RenderJob::RenderJob(
 	mCanceled(false),
 	mNextJob(NULL),
 	mCallbacks(callbacks),
-	mEngine(NULL)
+	mEngine(NULL),
+	mFuture(NULL),
+	mForceLink(false)
 {
 }
 
 
-//! @brief Constructor from job to duplicate and outputs filtering
-//! @param src The canceled job to copy
-//! @param dup Duplicate job context
-//! @param callbacks User callbacks instance (or NULL if none)
-//!
-//! Build a pending job from a canceled one and optionnaly pointer on an
-//! other job used to filter outputs.
-//! Push again SRC render tokens (of not filtered outputs).
-//! @warning Resulting job can be empty if all outputs are filtered. In this
-//!		case this job is no more usefull and can be removed.
-//! @note Called from user thread
-Substance::Details::RenderJob::RenderJob(
-		const RenderJob& src,
-		DuplicateJob& dup,
-		RenderCallbacks *callbacks) :
-	mUid(src.getUid()),
-	mState(State_Setup),
-	mCanceled(false),
-	mNextJob(NULL),
-	mLinkGraphs(dup.linkGraphs),
-	mCallbacks(callbacks)
+//! @brief Destructor
+Substance::Details::RenderJob::~RenderJob()
 {
-	mRenderPushIOs.reserve(src.mRenderPushIOs.size());
-	
-	SBS_VECTOR_FOREACH (RenderPushIO *srcpushio,src.mRenderPushIOs)
+	// Never processed (renderer deletion): release completion handle
+	if (mFuture!=NULL && mState!=State_Done)
 	{
-		RenderPushIO *newpushio = 
-			new RenderPushIO(*this,*srcpushio,dup);
-		if (newpushio->hasOutputs())
-		{
-			// Has outputs, push it in the list
-			mRenderPushIOs.push_back(newpushio);
-		}
-		else
-		{
-			// No outputs, all filtered
-			delete newpushio;
-		}
+		mFuture->jobDone(true);
 	}
-}
-
 
-//! @brief Destructor
-Substance::Details::RenderJob::~RenderJob()
-{
 	// Delete RenderPushIO elements
 	for (size_t i=0; i<mRenderPushIOs.size(); i++)
 	{
@@ -89,6 +55,35 @@ Substance::Details::RenderJob::~RenderJob()
 }
 
 
+//! @brief Attach the completion handle of the run this job belongs to
+//! @param future The completion handle, notified when job is done
+//! @pre Job must not be enqueued yet
+//! @note Called from user thread
+void Substance::Details::RenderJob::setFuture(RenderFuture* future)
+{
+	check(mFuture==NULL);
+	mFuture = future;
+	mFuture->addJob();
+}
+
+
+//! @brief Mark as complete
+//! Called from render thread.
+//! @warning When called, can be immediatly destroyed by user thread
+//!		(complete jobs cleanup)
+void Substance::Details::RenderJob::setComplete()
+{
+	// Notify before state change: job can be destroyed just after
+	if (mFuture!=NULL)
+	{
+		mFuture->jobDone(mCanceled);
+		mFuture = NULL;
+	}
+
+	mState = State_Done;
+}
+
+
 //! @brief Take states snapshot (used by linker)
 //! @param states Used to take a snapshot states to use at link time
 //!
@@ -197,20 +192,6 @@ bool Substance::Details::RenderJob::cancel(bool cancelList)
 }
 
 
-//! @brief Prepend reverted input delta into duplicate job context
-//! @param dup The duplicate job context to accumulate reversed delta
-//! Use to restore the previous state of copied jobs.
-//! @note Called from user thread
-void Substance::Details::RenderJob::prependRevertedDelta(
-	DuplicateJob& dup) const
-{
-	SBS_VECTOR_FOREACH (const RenderPushIO *pushio,mRenderPushIOs)
-	{
-		pushio->prependRevertedDelta(dup);
-	}
-}
-
-
 //! @brief Fill filter outputs structure from this job
 //! @param[in,out] filter The filter outputs structure to fill
 void Substance::Details::RenderJob::fill(OutputsFilter& filter) const
@@ -261,6 +242,11 @@ bool Substance::Details::RenderJob::isComplete() const
 //! @return Return if at least one graph state need to be linked
 bool Substance::Details::RenderJob::isLinkNeeded() const
 {
+	if (mForceLink)
+	{
+		return true;
+	}
+
 	if (!mRenderPushIOs.empty())
 	{
 		// Test only first one, others use graph state subset
@@ -19,12 +19,12 @@ namespace Substance
 
 struct FGraphInstance;
 struct RenderCallbacks;
+class RenderFuture;
 
 namespace Details
 {
 
 class Computation;
-struct DuplicateJob;
 class Engine;
 struct OutputsFilter;
 class RenderPushIO;
@@ -43,23 +43,19 @@ public:
 		State_Done       //!< Completely processed, to destroy in user thread
 	};
 	
+	//! @brief Order predicate, per render job UID (push order)
+	struct OrderPredicate
+	{
+		bool operator()(const RenderJob* a,const RenderJob* b) const
+		{
+			return a->getUid()<b->getUid();
+		}
+	};  // struct OrderPredicate
+	
 	//! @brief Constructor
 	//! @param callbacks User callbacks instance (or NULL if none)
 	RenderJob(uint32 uid,RenderCallbacks *callbacks);
 	
-	//! @brief Constructor from job to duplicate and outputs filtering
-	//! @param src The canceled job to copy
-	//! @param dup Duplicate job context
-	//! @param callbacks User callbacks instance (or NULL if none)
-	//!
-	//! Build a pending job from a canceled one and optionnaly pointer on an
-	//! other job used to filter outputs
-	//! Push again SRC render tokens (of not filtered outputs).
-	//! @warning Resulting job can be empty if all outputs are filtered. In this
-	//!		case this job is no more usefull and can be removed.
-	//! @note Called from user thread
-	RenderJob(const RenderJob& src,DuplicateJob& dup,RenderCallbacks *callbacks);
-
 	//! @brief Destructor
 	~RenderJob();
 	
@@ -69,6 +65,12 @@ public:
 	//! Must be done before activate it
 	void snapshotStates(const States &states);
 
+	//! @brief Force link at job processing, even w/o new graph state
+	//! Used to prune the states removed from the renderer (package moved to
+	//! an other worker).
+	//! @pre Job must be in 'Setup' state
+	void forceLink() { mForceLink = true; }
+
 	//! @brief Push I/O to render: from current state & current instance
 	//! @param graphState The current graph state
 	//! @param graphInstance The pushed graph instance (not keeped)
@@ -99,12 +101,6 @@ public:
 	//! coherency). RenderToken's are notified as canceled.
 	bool cancel(bool cancelList = false);
 	
-	//! @brief Prepend reverted input delta into duplicate job context
-	//! @param dup The duplicate job context to accumulate reversed delta
-	//! Use to restore the previous state of copied jobs.
-	//! @note Called from user thread
-	void prependRevertedDelta(DuplicateJob& dup) const;
-	
 	//! @brief Fill filter outputs structure from this job
 	//! @param[in,out] filter The filter outputs structure to fill
 	void fill(OutputsFilter& filter) const;
@@ -138,7 +134,13 @@ public:
 	//! Called from render thread.
 	//! @warning When called, can be immediatly destroyed by user thread
 	//!		(complete jobs cleanup)
-	void setComplete() { mState = State_Done; }
+	void setComplete();
+	
+	//! @brief Attach the completion handle of the run this job belongs to
+	//! @param future The completion handle, notified when job is done
+	//! @pre Job must not be enqueued yet
+	//! @note Called from user thread
+	void setFuture(RenderFuture* future);
 	
 	//! @brief Push input and output in engine handle
 	void pull(Computation &computation);
@@ -188,6 +190,12 @@ protected:
 
 	//! @brief Engine used for computation, filled when render job pulled
 	Engine* mEngine;
+	
+	//! @brief Completion handle of the run (NULL if none), not owned
+	RenderFuture* mFuture;
+
+	//! @brief Link required even if all graph states are linked
+	bool mForceLink;
 		
 private:
 	RenderJob(const RenderJob&);
@@ -10,7 +10,6 @@
 #include "SubstanceFGraph.h"
 
 #include "framework/details/detailsrenderpushio.h"
-#include "framework/details/detailsduplicatejob.h"
 #include "framework/details/detailscomputation.h"
 #include "framework/details/detailsgraphbinary.h"
 #include "framework/details/detailsgraphstate.h"
@@ -20,6 +19,7 @@
 #include "framework/details/detailsstates.h"
 
 #include "SubstanceCallbacks.h"
+#include "SubstanceCache.h"
 
 #include <iterator>
 #include <algorithm>
@@ -36,103 +36,6 @@ Substance::Details::RenderPushIO::RenderPushIO(RenderJob &renderJob) :
 {
 }
 
-//! @brief Constructor from push I/O to duplicate
-//! @param renderJob Parent render job that owns this instance
-//! @param src The canceled push I/O to copy
-//! @param dup Duplicate job context
-//! Build a push I/O from a canceled one and optionnaly filter outputs.
-//! Push again SRC render tokens (of not filtered outputs).
-//! @warning Resulting push I/O can be empty (hasOutputs()==false) if all
-//!		outputs are filtered OR already computed. In this case this push IO 
-//!		is no more usefull and can be removed.
-//! @note Called from user thread
-Substance::Details::RenderPushIO::RenderPushIO(
-		RenderJob &renderJob,
-		const RenderPushIO& src,
-		DuplicateJob& dup) :
-	mRenderJob(renderJob),
-	mState(State_None)
-{
-	OutputsFilter::Outputs foutsdummy;
-	
-	mInstances.reserve(src.mInstances.size());
-	SBS_VECTOR_FOREACH (const Instance *srcinst,src.mInstances)
-	{
-		// Skip if instance deleted
-		const substanceGuid_t uid = srcinst->instanceGuid;
-		FGraphInstance* ginst = dup.states.getInstanceFromUid(uid);
-		if (ginst==NULL)
-		{
-			// Deleted
-			continue;
-		}
-	
-		Instance *newinst = new Instance(*srcinst);
-
-		// Filter outputs
-		OutputsFilter::Outputs::const_iterator foutitecur = foutsdummy.end();
-		OutputsFilter::Outputs::const_iterator foutiteend = foutitecur;
-		if (dup.filter!=NULL)
-		{
-			OutputsFilter::Instances::const_iterator finstite = 
-				dup.filter->instances.find(uid);
-			if (finstite!=dup.filter->instances.end())
-			{
-				// If filtered and instance found, get iterator on indices
-				foutitecur = finstite->second.begin();
-				foutiteend = finstite->second.end();
-			}
-		}
-		
-		newinst->outputs.reserve(srcinst->outputs.size());
-		SBS_VECTOR_FOREACH (const Output& srcout,srcinst->outputs)
-		{
-			// Iterate on filtered outputs indices list in same time
-			while (foutitecur!=foutiteend && (*foutitecur)<srcout.index)
-			{
-				++foutitecur;
-			}
-		
-			if (!srcout.renderToken->isComputed() &&  // Skip if is computed
-				(foutitecur==foutiteend || 
-					(*foutitecur)!=srcout.index))     // Skip if filtered
-			{
-				// Duplicate output
-				newinst->outputs.push_back(srcout);
-				
-				// Push again SRC render tokens
-				srcout.renderToken->incrRef();
-				check(ginst->Outputs.size()>srcout.index);
-				ginst->Outputs[srcout.index].push(srcout.renderToken);
-			}
-		}
-		
-		if (newinst->outputs.empty())
-		{
-			// Pruned, accumulate delta state for next one
-			dup.append(uid,newinst->deltaState);
-		
-			// Delete instance
-			delete newinst;
-		}
-		else
-		{
-			// Has outputs, pust it
-			mInstances.push_back(newinst);
-			
-			// Fix delta state w/ accumulated delta
-			dup.fix(uid,newinst->deltaState);
-			
-			// Update state if necessary
-			if (dup.needUpdateState())
-			{
-				newinst->graphState.apply(newinst->deltaState);
-			}
-		}
-	}
-}
-
-
 //! @brief Destructor
 //! @note Called from user thread 
 Substance::Details::RenderPushIO::~RenderPushIO()
@@ -169,20 +72,6 @@ bool Substance::Details::RenderPushIO::push(
 }
 
 
-//! @brief Prepend reverted input delta into duplicate job context
-//! @param dup The duplicate job context to accumulate reversed delta
-//! Use to restore the previous state of copied jobs.
-//! @note Called from user thread
-void Substance::Details::RenderPushIO::prependRevertedDelta(
-	DuplicateJob& dup) const
-{
-	SBS_VECTOR_FOREACH (const Instance *instance,mInstances)
-	{
-		dup.prepend(instance->instanceGuid,instance->deltaState);
-	}
-}
-	
-
 //! @brief Push input and output in engine handle
 //! @param inputsOnly If true only inputs are pushed
 //! @post Push I/O state is reverted to correct State_xxxPending(s)
@@ -464,6 +353,10 @@ Substance::Details::RenderPushIO::Instance::Instance(
 	uint32 outindex = 0;
 	outputs.reserve(graphInstance->Outputs.size());
 
+	// Disk cache keys of the dirty outputs: the inputs may change before 
+	// the results are published
+	SubstanceCache::Get()->SnapshotKeys(graphInstance);
+
 	Substance::List<output_inst_t>::TIterator ItOut(graphInstance->Outputs.itfront());
 	for (;ItOut;++ItOut)
 	{
@@ -494,15 +387,6 @@ Substance::Details::RenderPushIO::Instance::Instance(
 }
 
 
-//! @brief Duplicate instance (except outputs)
-Substance::Details::RenderPushIO::Instance::Instance(const Instance &src) :
-	graphState(src.graphState),
-	instanceGuid(src.instanceGuid),
-	deltaState(src.deltaState)
-{
-}
-
-
 //! @brief Accessor: At least one output to compute
 //! Check all render tokens if not already filled
 bool Substance::Details::RenderPushIO::Instance::hasOutputs() const
@@ -39,18 +39,6 @@ public:
 	//! @note Called from user thread 
 	RenderPushIO(RenderJob &renderJob);
 	
-	//! @brief Constructor from push I/O to duplicate
-	//! @param renderJob Parent render job that owns this instance
-	//! @param src The canceled push I/O to copy
-	//! @param dup Duplicate job context
-	//! Build a push I/O from a canceled one and optionnaly filter outputs.
-	//! Push again SRC render tokens (of not filtered outputs).
-	//! @warning Resulting push I/O can be empty (hasOutputs()==false) if all
-	//!		outputs are filtered OR already computed. In this case this push IO 
-	//!		is no more usefull and can be removed.
-	//! @note Called from user thread
-	RenderPushIO(RenderJob &renderJob,const RenderPushIO& src,DuplicateJob& dup);
-	
 	//! @brief Destructor
 	//! @note Called from user thread 
 	~RenderPushIO();
@@ -62,12 +50,6 @@ public:
 	//! @return Return true if at least one dirty output
 	bool push(GraphState &graphState, FGraphInstance* graphInstance);
 	
-	//! @brief Prepend reverted input delta into duplicate job context
-	//! @param dup The duplicate job context to accumulate reversed delta
-	//! Use to restore the previous state of copied jobs.
-	//! @note Called from user thread
-	void prependRevertedDelta(DuplicateJob& dup) const;
-
 	//! @brief Push input and output in engine handle
 	//! @param inputsOnly If true only inputs are pushed
 	//! @post Push I/O state is reverted to correct State_xxxPending(s)
@@ -154,9 +136,6 @@ protected:
 			GraphState &state,
 			FGraphInstance* graphInstance);
 			
-		//! @brief Duplicate instance (except outputs)
-		Instance(const Instance &src);
-			
 		//! @brief GraphState associated to this instance
 		GraphState &graphState;
 			
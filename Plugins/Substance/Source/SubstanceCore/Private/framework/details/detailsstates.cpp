@@ -7,6 +7,7 @@
 
 #include "SubstanceCorePrivatePCH.h"
 #include "SubstanceFGraph.h"
+#include "SubstanceFPackage.h"
 
 #include "framework/details/detailsstates.h"
 #include "framework/details/detailsgraphstate.h"
@@ -37,6 +38,34 @@ void Substance::Details::States::clear()
 }
 
 
+//! @brief Remove the states of all instances of a package
+//! @param packageGuid GUID of the package of the instances to remove
+//! @note Called from user thread 
+//! @return Return true if at least one state is removed
+bool Substance::Details::States::releasePackage(
+	const substanceGuid_t& packageGuid)
+{
+	bool hasRelease = false;
+
+	for (auto itMap = InstancesMap.begin(); itMap != InstancesMap.end();)
+	{
+		FGraphInstance* instance = itMap->second.instance;
+		if (instance->Desc->Parent->Guid==packageGuid)
+		{
+			instance->unplugState(this);
+			InstancesMap.erase(itMap++);
+			hasRelease = true;
+		}
+		else
+		{
+			++itMap;
+		}
+	}
+
+	return hasRelease;
+}
+
+
 //! @brief Get the GraphState associated to this graph instance
 //! @param graphInstance The source graph instance
 //! @note Called from user thread 
@@ -24,6 +24,9 @@ namespace Substance
 		SUBSTANCECORE_API void RenderAsync(Substance::List<graph_inst_t*>&);
 		SUBSTANCECORE_API void RenderAsync(graph_inst_t*);
 
+		//! @brief Same as RenderAsync, rendered at visible priority
+		void RenderVisible(graph_inst_t*);
+
 		//! @brief Perform a blocking rendering of those instances
 		SUBSTANCECORE_API void RenderSync(Substance::List<graph_inst_t*>&);
 		SUBSTANCECORE_API void RenderSync(graph_inst_t*);
@@ -49,7 +52,47 @@ namespace Substance
 		void PerformDelayedRender();
 
 		//! @brief Update Texture Output
-		void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults = true);
+		//! @param AdoptedResult Render result of the output, its buffer is uploaded without copy
+		//!		and released after upload (ownership is taken), not adopted in editor.
+		void UpdateTexture(const SubstanceTexture& result, output_inst_t* Output, bool bCacheResults = true, output_inst_t::Result* AdoptedResult = NULL);
+
+		//! @brief Copy 8 bits RGBA pixels to BGRA (or BGRA to RGBA)
+		//! @param Size Size in bytes, multiple of 4
+		//! @note Vectorized on SSE2 and NEON platforms, Dest can be Src
+		void CopySwizzleRGBA(void* Dest, const void* Src, SIZE_T Size);
+
+		//! @brief Scalar version of CopySwizzleRGBA, used for the remaining pixels
+		//!	and as the reference of the Substance.Bench.Swizzle benchmark
+		void CopySwizzleRGBAScalar(void* Dest, const void* Src, SIZE_T Size);
+
+		//! @brief Lock the bulk data of a mip for writing, its storage is reused if it has the right size
+		//! @param bOutReused Set to true if the storage is reused: it holds the previous content
+		//! @return Return the mip data, to unlock after writing
+		void* LockMipForWrite(struct FTexture2DMipMap* MipMap, SIZE_T ImageSize, bool* bOutReused = NULL);
+
+		//! @brief Write the content of a mip, swizzled from RGBA if requested
+		//! @param bCompare Compare with the current content of Dest, only the differences are written
+		//! @return Return true if the content changed (always if not compared)
+		bool WriteMipData(void* Dest, const void* Src, SIZE_T Size, bool bSwizzle, bool bCompare);
+
+		//! @brief Update the mips of a texture from a render result
+		//! @param bCopyMips If false, the mips bulk data are emptied: the result buffer is the upload source
+		//! @param CompressedFormat Block format the raw result is compressed to, PF_Unknown to keep it (see BlockCompression)
+		//! @param OutChangedMips Set to the mask of the mips whose content changed
+		//! @return Return true if the size, format or mips count changed (resource to recreate)
+		bool UpdateSubstanceOutput(USubstanceTexture2D* Texture, const SubstanceTexture& ResultText, bool bCopyMips = true, EPixelFormat CompressedFormat = PF_Unknown, uint32* OutChangedMips = NULL);
+
+		//! @brief Size of a render result once uploaded, all mips included
+		SIZE_T GetResultSize(const SubstanceTexture& Result);
+
+		//! @brief Publish computed outputs until the per frame upload budget is spent
+		//! @return Return true if at least one output has been published
+		bool PublishComputedOutputs();
+
+		//! @brief Publish the outputs of the graph instances read from the cache in the
+		//! background, the graph instances whose reads failed are queued for rendering
+		//! @return Return true if at least one graph instance has been published
+		bool PublishCachedOutputs();
 
 		//! @brief Perform per frame Substance management
 		SUBSTANCECORE_API void Tick();
@@ -60,6 +103,7 @@ namespace Substance
 		//! @brief Create a texture 2D object using an output instance desc.
 		SUBSTANCECORE_API void CreateSubstanceTexture2D(FOutputInstance* OutputInstance, bool bTransient = false, FString Name = FString(), UObject* InOuter=NULL);
 
+		//! @brief Make the enabled outputs of an instance show the shared placeholder texture until rendered
 		SUBSTANCECORE_API void CreatePlaceHolderMips(graph_inst_t* Instance);
 
 		//! @brief used to create a graph instance object
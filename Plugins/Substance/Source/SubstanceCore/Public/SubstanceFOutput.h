@@ -102,6 +102,10 @@ namespace Substance
 
 		bool queueRender();                                     //!< Internal use only
 
+		volatile int32 ComputedQueued;                          //!< Internal use only, non-zero if in computed outputs queue (Details::OutputQueue::ComputedState)
+
+		FOutputInstance* volatile ComputedNext;                 //!< Internal use only, next deferred output of the computed outputs queue
+
 	protected:
 		void releaseTokensOwnedByEngine(uint32 engineUid);
 
@@ -16,6 +16,8 @@
 #include <string>
 #include <utility>
 
+class FSHA1;
+
 namespace Substance
 {
 namespace Details
@@ -38,6 +40,11 @@ public:
 	//! @param cxt Used to push link data
 	virtual bool push(LinkContext& cxt) const = 0;
 
+	//! @brief Accumulate a stable hash of the data pushed to link
+	//! @param hashState SHA1 state to update
+	//! Used as key of the linked SBSBIN disk cache (LinkCache).
+	virtual void hash(FSHA1& hashState) const = 0;
+
 private:
 	LinkData(const LinkData&);
 	const LinkData& operator=(const LinkData&);
@@ -59,6 +66,10 @@ public:
 	//! @brief Push data to link
 	//! @param cxt Used to push link data
 	bool push(LinkContext& cxt) const;
+
+	//! @brief Accumulate a stable hash of the data pushed to link
+	//! @param hashState SHA1 state to update
+	void hash(FSHA1& hashState) const;
 	
 	//! @brief Force output format/mipmap
 	//! @param uid Output uid
@@ -73,11 +84,13 @@ public:
 	void clear()
 	{
 		mAssembly.clear();
+		updateAssemblyHash();
 	}
 
 	void zeroAssembly()
 	{
 		mAssembly.assign(mAssembly.size(), 0);
+		updateAssemblyHash();
 	}
 
 	//! @brief Accessor to the assembly
@@ -103,6 +116,13 @@ protected:
 	
 	//! @brief Output formats override
 	OutputFormats mOutputFormats;
+
+	//! @brief SHA1 digest of mAssembly, updated each time it is modified
+	//! Read only by hash(): can be used concurrently by several workers
+	uint8 mAssemblyHash[20];
+
+	//! @brief Compute mAssemblyHash from current assembly data
+	void updateAssemblyHash();
 	
 };  // class LinkDataAssembly
 
@@ -126,6 +146,10 @@ public:
 	//! @brief Push data to link
 	//! @param cxt Used to push link data
 	bool push(LinkContext& cxt) const;
+
+	//! @brief Accumulate a stable hash of the data pushed to link
+	//! @param hashState SHA1 state to update
+	void hash(FSHA1& hashState) const;
 	
 	//! @brief Connections options.
 	ConnectionsOptions mOptions;
@@ -60,6 +60,15 @@ public:
 	//! @note Called from user thread 
 	void clear();
 
+	//! @brief Remove the states of all instances of a package
+	//! @param packageGuid GUID of the package of the instances to remove
+	//! @note Called from user thread 
+	//! @return Return true if at least one state is removed
+	//!
+	//! Graph states still referenced by render jobs snapshots are kept 
+	//! alive until these jobs are deleted.
+	bool releasePackage(const substanceGuid_t& packageGuid);
+
 	//! @brief Clear all render token w/ render results from a specific engine
 	//! @brief Must be called from user thread. Not thread safe, can't be 
 	//!		called if render ongoing.
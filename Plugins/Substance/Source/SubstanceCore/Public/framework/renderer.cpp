@@ -7,7 +7,7 @@
 
 #include "SubstanceFGraph.h"
 
-#include "framework/details/detailsrendererimpl.h"
+#include "framework/details/detailsrendererpool.h"
 #include "framework/details/detailslinkdata.h"
 #include "framework/renderer.h"
 
@@ -15,15 +15,18 @@
 DEFINE_LOG_CATEGORY_STATIC(LogSbsRender, Warning, All);
 
 
+FThreadSafeCounter Substance::RenderOptions::mSettingsGeneration;
+
+
 Substance::Renderer::Renderer(const RenderOptions& renderOptions) :
-	mRendererImpl(new Details::RendererImpl(renderOptions))
+	mRendererPool(new Details::RendererPool(renderOptions))
 {
 }
 
 
 Substance::Renderer::~Renderer()
 {
-	delete mRendererImpl;
+	delete mRendererPool;
 }
 
 
@@ -39,7 +42,7 @@ void Substance::Renderer::push(Substance::FGraphInstance* graph)
 		return;
 	}
 	
-	mRendererImpl->push(graph);
+	mRendererPool->push(graph);
 }
 
 
@@ -55,55 +58,95 @@ void Substance::Renderer::push(Substance::List<Substance::FGraphInstance*>& grap
 }
 
 
-int32 Substance::Renderer::run(uint32 runOptions)
+int32 Substance::Renderer::run(uint32 runOptions, RunPriority priority)
 {
-	return mRendererImpl->run(runOptions);
+	return mRendererPool->run(runOptions, priority);
+}
+
+
+Substance::RenderFuture::SPtr Substance::Renderer::runAsync(
+	uint32 runOptions,
+	RunPriority priority)
+{
+	RenderFuture::SPtr future(new RenderFuture());
+	mRendererPool->run(runOptions|Run_Asynchronous, priority, future);
+	return future;
+}
+
+
+void Substance::Renderer::dispatchCompletions()
+{
+	mRendererPool->dispatchCompletions();
 }
 
 
 bool Substance::Renderer::cancel(uint32 runUid)
 {
-	return mRendererImpl->cancel(runUid);
+	return mRendererPool->cancel(runUid);
 }
 
 
 void Substance::Renderer::cancelAll()
 {
-	mRendererImpl->cancel();
+	mRendererPool->cancel();
 }
 
 
 void Substance::Renderer::flush()
 {
-	mRendererImpl->flush();
+	mRendererPool->flush();
 }
 
 
 void Substance::Renderer::clearCache()
 {
-	mRendererImpl->clearCache();
+	mRendererPool->clearCache();
+}
+
+
+void Substance::Renderer::trim(size_t targetBytes)
+{
+	mRendererPool->trim(targetBytes);
 }
 
 
 bool Substance::Renderer::isPending(uint32 runUid) const
 {
-	return mRendererImpl->isPending(runUid);
+	return mRendererPool->isPending(runUid);
 }
 
 
 void Substance::Renderer::hold()
 {
-	mRendererImpl->hold();
+	mRendererPool->hold();
 }
 
 
 void Substance::Renderer::resume()
 {
-	mRendererImpl->resume();
+	mRendererPool->resume();
+}
+
+
+void Substance::Renderer::setOptions(const RenderOptions& renderOptions)
+{
+	mRendererPool->setOptions(renderOptions);
+}
+
+
+void Substance::Renderer::resetOptions()
+{
+	mRendererPool->resetOptions();
+}
+
+
+void Substance::Renderer::setCoresLimit(size_t coresCount)
+{
+	mRendererPool->setCoresLimit(coresCount);
 }
 
 
 void Substance::Renderer::setRenderCallbacks(RenderCallbacks* callbacks)
 {
-	mRendererImpl->setRenderCallbacks(callbacks);
+	mRendererPool->setRenderCallbacks(callbacks);
 }
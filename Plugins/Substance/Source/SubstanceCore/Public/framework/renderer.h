@@ -9,6 +9,7 @@
 #include "SubstanceFGraph.h"
 #include "SubstanceCallbacks.h"
 #include "renderopt.h"
+#include "renderfuture.h"
 
 #include <map>
 
@@ -17,7 +18,7 @@ namespace Substance
 
 namespace Details
 {
-	class RendererImpl;
+	class RendererPool;
 }
 
 //! @brief Class used to render graph instances
@@ -25,20 +26,33 @@ class Renderer
 {
 public:
 	//! @brief Run options enumeration used as argument by run() method
-	//! Options can be combined. Run_PreserveRun is only useful w/ Run_Replace
-	//! and/or Run_First flags (useful w/ burst run() calls).
+	//! Options can be combined. A running job is never canceled by a new
+	//! run, Run_PreserveRun is kept for compatibility.
 	enum RunOption
 	{
 		Run_Default      = 0,  //!< Synchronous, preserve previous push
 		Run_Asynchronous = 1,  //!< Asynchronous computation 
-		Run_Replace      = 2,  //!< Discard computation on deprecated outputs
-		Run_First        = 4,  //!< Run w/ maximum priority on other computation
+		Run_Replace      = 2,  //!< Discard queued jobs w/ deprecated outputs
+		Run_First        = 4,  //!< Run before other jobs of the same priority
 		Run_PreserveRun  = 8   //!< In any case, preserve currently running job 
 	};
 
+	//! @brief Run priority classes used as argument by run() method
+	//! Jobs of higher classes are processed first, FIFO order inside a 
+	//! class. Preemption occurs at render job granularity: a job already
+	//! computing is never canceled by a higher priority one.
+	enum RunPriority
+	{
+		Priority_Background  = 0,  //!< Background/prefetch generation
+		Priority_Interactive = 1,  //!< Editor interactive instances
+		Priority_Visible     = 2,  //!< Visible/near camera instances
+		Priority_Count,
+		Priority_Default     = Priority_Visible
+	};
+
 	//! @brief Default constructor
 	//! @param renderOptions Optional render options. Allows to set initial
-	//!		memory consumption budget.
+	//!		memory consumption budget and the count of engine workers.
 	Renderer(const RenderOptions& renderOptions = RenderOptions());
 
 	//! @brief Destructor
@@ -61,6 +75,7 @@ public:
 
 	//! @brief Launch synchronous/asynchronous computation
 	//! @param runOptions Combination of RunOption flags
+	//! @param priority Priority class of the computation
 	//! @post If synchronous mode selected (default): Render results are 
 	//!		available in output instances (OutputInstance::grabResult()).
 	//! @return Return UID of render job or 0 if not pushed computation to run.
@@ -68,7 +83,27 @@ public:
 	//! Render previously pushed GraphInstance's.
 	//! Returns after computation end in synchronous mode, otherwise
 	//! returns immediatly.
-	int32 run(uint32 runOptions = Run_Default);
+	int32 run(
+		uint32 runOptions = Run_Default,
+		RunPriority priority = Priority_Default);
+
+	//! @brief Launch computation, return a completion handle
+	//! @param runOptions Combination of RunOption flags, Run_Asynchronous
+	//!		is implied
+	//! @param priority Priority class of the computation
+	//! @return Return the completion handle of the run, never NULL. If
+	//!		nothing was pushed, the handle is already done (run UID is 0).
+	//!
+	//! Continuations added to the handle (RenderFuture::then()) are fired 
+	//! from the thread calling dispatchCompletions() or flush(), never from 
+	//! render threads.
+	RenderFuture::SPtr runAsync(
+		uint32 runOptions = Run_Asynchronous,
+		RunPriority priority = Priority_Default);
+
+	//! @brief Fire the continuations of the completed runs
+	//! Call it periodically from the thread that launches the runs.
+	void dispatchCompletions();
 	
 	//! @brief Cancel a computation
 	//! @param runUid UID of the computation to cancel (returned by run())
@@ -81,6 +116,15 @@ public:
 	//! @brief Clear the substance cache
 	void clearCache();
 
+	//! @brief Release engine intermediate caches and pending textures
+	//! @param targetBytes Memory budget to shrink the engine caches to, 0 to
+	//!		release all of them.
+	//!
+	//! Linker, engine handle and render thread are kept alive. Does not 
+	//! block: posted to the render threads, each engine is trimmed once it
+	//! has no render job left.
+	void trim(size_t targetBytes = 0);
+
 	//! @brief Flush computation, wait for all render jobs to be complete
 	void flush();
 	
@@ -94,6 +138,21 @@ public:
 	//! @brief Continue held rendering
 	void resume();
 	
+	//! @brief Set per-renderer memory budget and CPU usage
+	//! @param renderOptions New render options to use.
+	//! Overrides USubstanceSettings values until resetOptions() is called,
+	//! applied by the render thread at next render job boundary.
+	//! @note Can be called at any time, from any thread.
+	void setOptions(const RenderOptions& renderOptions);
+	
+	//! @brief Use USubstanceSettings values again (discard setOptions())
+	void resetOptions();
+	
+	//! @brief Limit the CPU cores count used by the engine
+	//! @param coresCount Maximum cores count, 0 to remove the limit
+	//! Applied by the render thread at next render job boundary.
+	void setCoresLimit(size_t coresCount);
+	
 	//! @brief Set per-renderer user callbacks
 	//! @param callbacks Pointer on the user callbacks concrete structure 
 	//! 	instance that will be used for this renderer instance callbacks
@@ -105,7 +164,7 @@ public:
 	void setRenderCallbacks(RenderCallbacks* callbacks);
 
 protected:
-	Details::RendererImpl* mRendererImpl;
+	Details::RendererPool* mRendererPool;
 };
 
 } // namespace Substance
@@ -0,0 +1,76 @@
+//! @file renderfuture.cpp
+//! @brief Implementation of Substance render completion handle
+//! @author Christophe Soum - Allegorithmic
+//! @copyright Allegorithmic. All rights reserved.
+
+#include "SubstanceCorePrivatePCH.h"
+
+#include "framework/renderfuture.h"
+
+
+Substance::RenderFuture::RenderFuture() :
+	mRunUid(0),
+	mPendingJobs(0),
+	mCanceled(0),
+	mDispatched(false)
+{
+}
+
+
+Substance::RenderFuture::~RenderFuture()
+{
+	check(isDone());
+}
+
+
+void Substance::RenderFuture::then(
+	const FRenderCompleteDelegate& continuation)
+{
+	if (mDispatched)
+	{
+		continuation.ExecuteIfBound(*this);
+	}
+	else
+	{
+		mContinuations.Add(continuation);
+	}
+}
+
+
+void Substance::RenderFuture::addJob()
+{
+	FPlatformAtomics::InterlockedIncrement(&mPendingJobs);
+}
+
+
+void Substance::RenderFuture::jobDone(bool canceled)
+{
+	if (canceled)
+	{
+		FPlatformAtomics::InterlockedExchange(&mCanceled,1);
+	}
+
+	// Last access from render thread: the handle can be dispatched and
+	// released by user thread as soon as the count reaches 0
+	FPlatformAtomics::InterlockedDecrement(&mPendingJobs);
+}
+
+
+bool Substance::RenderFuture::dispatch()
+{
+	if (!mDispatched && isDone())
+	{
+		mDispatched = true;
+
+		// Continuations may add continuations: they are called immediately
+		TArray<FRenderCompleteDelegate> continuations;
+		Exchange(continuations,mContinuations);
+
+		for (int32 i=0;i<continuations.Num();++i)
+		{
+			continuations[i].ExecuteIfBound(*this);
+		}
+	}
+
+	return mDispatched;
+}
@@ -0,0 +1,103 @@
+//! @file renderfuture.h
+//! @brief Substance render completion handle, returned by asynchronous runs
+//! @author Christophe Soum - Allegorithmic
+//! @copyright Allegorithmic. All rights reserved.
+
+#ifndef _SUBSTANCE_FRAMEWORK_RENDERFUTURE_H
+#define _SUBSTANCE_FRAMEWORK_RENDERFUTURE_H
+
+#include "SubstanceCoreTypedefs.h"
+
+#include <memory>
+
+namespace Substance
+{
+
+namespace Details
+{
+	class RenderJob;
+	class RendererPool;
+}
+
+class Renderer;
+class RenderFuture;
+
+//! @brief Continuation called when a render run is complete
+DECLARE_DELEGATE_OneParam(FRenderCompleteDelegate, const RenderFuture&);
+
+//! @brief Completion handle of a render run (see Renderer::runAsync())
+//! The run is done when all its render jobs are processed by the render
+//! threads (computed or canceled). Continuations are never called from
+//! render threads: they are fired by the user thread that polls the
+//! renderer (Renderer::dispatchCompletions() or Renderer::flush()).
+class RenderFuture
+{
+public:
+	//! @brief Shared pointer on completion handle
+	typedef std::shared_ptr<RenderFuture> SPtr;
+
+	//! @brief Destructor
+	~RenderFuture();
+
+	//! @brief Accessor on the run UID (0 if nothing was pushed to run)
+	uint32 getRunUid() const { return mRunUid; }
+
+	//! @brief Return if all render jobs of the run are processed
+	//! @note Can be called from any thread
+	bool isDone() const { return mPendingJobs==0; }
+
+	//! @brief Return if at least one render job of the run was canceled
+	//! @note Only relevant when isDone() returns true
+	bool isCanceled() const { return mCanceled!=0; }
+
+	//! @brief Add a continuation, called once when the run is complete
+	//! @param continuation The delegate to call
+	//! @note Called from user thread. If the completion is already
+	//!		dispatched, the continuation is called immediately.
+	void then(const FRenderCompleteDelegate& continuation);
+
+protected:
+	//! @brief Constructor, internal use only (see Renderer::runAsync())
+	RenderFuture();
+
+	//! @brief Register a render job of the run
+	//! @note Called from user thread, before the job is enqueued
+	void addJob();
+
+	//! @brief Notify a render job of the run as processed
+	//! @param canceled True if the job was canceled
+	//! @note Called from render thread
+	void jobDone(bool canceled);
+
+	//! @brief Fire the continuations if done and not already dispatched
+	//! @return Return true if dispatched (now or before)
+	//! @note Called from user thread
+	bool dispatch();
+
+	//! @brief Pool run UID
+	uint32 mRunUid;
+
+	//! @brief Count of render jobs not yet processed
+	volatile int32 mPendingJobs;
+
+	//! @brief Non zero if at least one job was canceled
+	volatile int32 mCanceled;
+
+	//! @brief Continuations already fired
+	bool mDispatched;
+
+	//! @brief Continuations to fire at dispatch
+	TArray<FRenderCompleteDelegate> mContinuations;
+
+	friend class Renderer;
+	friend class Details::RenderJob;
+	friend class Details::RendererPool;
+
+private:
+	RenderFuture(const RenderFuture&);
+	const RenderFuture& operator=(const RenderFuture&);
+};
+
+} // namespace Substance
+
+#endif // _SUBSTANCE_FRAMEWORK_RENDERFUTURE_H
@@ -22,15 +22,42 @@ struct RenderOptions
 
 	size_t mCoresCount;
 
+	//! @brief Count of engine workers (one linker/handle each).
+	//! Memory budget and cores are shared between workers.
+	size_t mWorkersCount;
+
+	//! @brief Use the linked SBSBIN disk cache
+	bool mLinkCache;
+
+	//! @brief Maximum size of the linked SBSBIN disk cache in bytes, 0 for
+	//! no limit
+	size_t mLinkCacheMaxSize;
+
 	//! @brief Default constructor
 	RenderOptions()
 	{
 		int32 BudgetMb = FMath::Clamp(GetDefault<USubstanceSettings>()->MemoryBudgetMb, SBS_MIN_MEM_BUDGET, SBS_MAX_MEM_BUDGET);
 		int32 CPUCores = FMath::Clamp(GetDefault<USubstanceSettings>()->CPUCores, (int32)1, FPlatformMisc::NumberOfCores());
+		int32 Workers = FMath::Clamp(GetDefault<USubstanceSettings>()->RenderWorkers, (int32)1, CPUCores);
 
 		mMemoryBudget = BudgetMb * 1024 * 1024;
 		mCoresCount = CPUCores;
+		mWorkersCount = Workers;
+		mLinkCache = GetDefault<USubstanceSettings>()->bCacheLinkedBinaries;
+		mLinkCacheMaxSize = (size_t)FMath::Max(GetDefault<USubstanceSettings>()->LinkCacheMaxSizeMb, (int32)0) * 1024 * 1024;
 	}
+
+	//! @brief Notify that USubstanceSettings changed, bump settings generation
+	//! Renderers following the settings reload their options only when the
+	//! generation changes.
+	static void notifySettingsChanged() { mSettingsGeneration.Increment(); }
+
+	//! @brief Accessor on current settings generation
+	static uint32 getSettingsGeneration() { return mSettingsGeneration.GetValue(); }
+
+protected:
+	//! @brief Settings generation counter
+	static FThreadSafeCounter mSettingsGeneration;
 };
 
 } // namespace Substance